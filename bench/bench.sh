@@ -0,0 +1,54 @@
+#!/bin/sh
+# Compare the default, release and pgo builds over the bench corpus.
+# Usage: sh bench/bench.sh   (RUNS=N to change repetitions, best run is kept)
+set -e
+cd "$(dirname "$0")/.."
+
+RUNS=${RUNS:-3}
+BIN_DIR=bench/bin
+WORK_DIR=$BIN_DIR/run
+BUILDS="default release pgo"
+
+make -s corpus
+mkdir -p "$WORK_DIR"
+
+make -s TARGET=$BIN_DIR/xlsx_to_tsv.default all
+make -s TARGET=$BIN_DIR/xlsx_to_tsv.release release
+make -s TARGET=$BIN_DIR/xlsx_to_tsv.pgo PGO_DIR=$BIN_DIR/pgo-data pgo > /dev/null
+
+# Best wall time (seconds) of RUNS runs: best_time <binary> <input.xlsx>
+best_time() {
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(date +%s.%N)
+        (cd "$WORK_DIR" && "$1" "$2" > /dev/null)
+        end=$(date +%s.%N)
+        echo "$start $end"
+        i=$((i + 1))
+    done | awk '{ t = $2 - $1; if (NR == 1 || t < best) best = t } END { printf "%.3f\n", best }'
+}
+
+RESULTS=$BIN_DIR/results.txt
+: > "$RESULTS"
+for f in bench/corpus/*.xlsx; do
+    for b in $BUILDS; do
+        echo "$(basename "$f") $b $(best_time "$(pwd)/$BIN_DIR/xlsx_to_tsv.$b" "$(pwd)/$f")" >> "$RESULTS"
+    done
+done
+
+awk -v builds="$BUILDS" '
+    BEGIN { n = split(builds, b, " ") }
+    {
+        if (!($1 in seen)) { seen[$1] = 1; order[++rows] = $1 }
+        t[$1, $2] = $3; total[$2] += $3
+    }
+    END {
+        printf "%-14s", "input"; for (i = 1; i <= n; i++) printf "%12s", b[i]; printf "\n"
+        for (r = 1; r <= rows; r++) {
+            printf "%-14s", order[r]
+            for (i = 1; i <= n; i++) printf "%11.3fs", t[order[r], b[i]]
+            printf "\n"
+        }
+        printf "%-14s", "total"; for (i = 1; i <= n; i++) printf "%11.3fs", total[b[i]]; printf "\n"
+        printf "%-14s", "speedup"; for (i = 1; i <= n; i++) printf "%11.2fx", total[b[1]] / total[b[i]]; printf "\n"
+    }' "$RESULTS"
@@ -0,0 +1,69 @@
+#!/bin/sh
+# Compare --format=col (.xcol) with TSV output on the bench corpus: output
+# size, and the time to sum one numeric column (awk over the TSV vs
+# xlsx2col-cat --sum). Also checks that xlsx2col-cat reproduces every TSV.
+# Usage: sh bench/columnar.sh   (RUNS=N to change repetitions, best run is kept)
+set -e
+cd "$(dirname "$0")/.."
+
+RUNS=${RUNS:-3}
+WORK_DIR=bench/bin/columnar
+ROOT=$(pwd)
+BIN=$ROOT/xlsx_to_tsv
+CAT=$ROOT/xlsx2col-cat
+
+make -s corpus
+make -s all
+
+# Best wall time (seconds) of RUNS runs of a command
+best_time() {
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(date +%s.%N)
+        "$@" > /dev/null
+        end=$(date +%s.%N)
+        echo "$start $end"
+        i=$((i + 1))
+    done | awk '{ t = $2 - $1; if (NR == 1 || t < best) best = t } END { printf "%.4f\n", best }'
+}
+
+awk_sum() {
+    awk -F'\t' -v k="$2" 'NR > 1 { s += $k } END { printf "%.15g\n", s }' "$1"
+}
+
+printf "%-10s%11s%11s%8s%11s%11s%9s\n" "input" "tsv" "xcol" "ratio" "awk sum" "xcol sum" "speedup"
+for f in bench/corpus/*.xlsx; do
+    name=$(basename "$f" .xlsx)
+    rm -rf "$WORK_DIR/$name" && mkdir -p "$WORK_DIR/$name/tsv" "$WORK_DIR/$name/col"
+    (cd "$WORK_DIR/$name/tsv" && "$BIN" "$ROOT/$f" > /dev/null)
+    (cd "$WORK_DIR/$name/col" && "$BIN" "$ROOT/$f" --format=col > /dev/null)
+
+    tsv_bytes=0; col_bytes=0; ta=0; tc=0
+    for x in "$WORK_DIR/$name"/col/*.xcol; do
+        sheet=$(basename "$x" .xcol)
+        t="$WORK_DIR/$name/tsv/$sheet.tsv"
+        if ! "$CAT" "$x" | cmp -s - "$t"; then
+            echo "Error: $name/$sheet: xlsx2col-cat output differs from the TSV" >&2
+            exit 1
+        fi
+
+        # First int64/double column, else the first column
+        column=$("$CAT" "$x" --info | awk -F'\t' 'NR > 7 && /int64|double/ { print $1; exit }')
+        [ -n "$column" ] || column=$(head -1 "$t" | cut -f1)
+        k=$(head -1 "$t" | tr '\t' '\n' | grep -nx -- "$column" | head -1 | cut -d: -f1)
+        if [ "$(awk_sum "$t" "$k")" != "$("$CAT" "$x" --sum="$column" | sed 's/.*sum=\([^\t]*\).*/\1/')" ]; then
+            echo "Error: $name/$sheet: sums of $column differ" >&2
+            exit 1
+        fi
+
+        tsv_bytes=$((tsv_bytes + $(wc -c < "$t")))
+        col_bytes=$((col_bytes + $(wc -c < "$x")))
+        ta=$(echo "$ta $(best_time awk_sum "$t" "$k")" | awk '{ print $1 + $2 }')
+        tc=$(echo "$tc $(best_time "$CAT" "$x" --sum="$column")" | awk '{ print $1 + $2 }')
+    done
+
+    echo "$name $tsv_bytes $col_bytes $ta $tc"
+done | awk '{
+    printf "%-10s%10.1fM%10.1fM%7.2fx%10.3fs%10.3fs%8.1fx\n", $1, $2 / 1048576, $3 / 1048576, $2 / $3, $4, $5, $4 / $5
+    tb += $2; cb += $3; ta += $4; tc += $5
+} END { printf "%-10s%10.1fM%10.1fM%7.2fx%10.3fs%10.3fs%8.1fx\n", "total", tb / 1048576, cb / 1048576, tb / cb, ta, tc, ta / tc }'
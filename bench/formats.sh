@@ -0,0 +1,45 @@
+#!/bin/sh
+# Compare xlsx and xlsb throughput for the same workbooks in the bench corpus
+# and check that both formats produce identical TSV output.
+# Usage: sh bench/formats.sh   (RUNS=N to change repetitions, best run is kept)
+set -e
+cd "$(dirname "$0")/.."
+
+RUNS=${RUNS:-3}
+WORK_DIR=bench/bin/formats
+BIN=$(pwd)/xlsx_to_tsv
+
+make -s corpus
+make -s all
+
+# Best wall time (seconds) of RUNS runs: best_time <input> <output dir>
+best_time() {
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        rm -rf "$2" && mkdir -p "$2"
+        start=$(date +%s.%N)
+        (cd "$2" && "$BIN" "$1" > /dev/null)
+        end=$(date +%s.%N)
+        echo "$start $end"
+        i=$((i + 1))
+    done | awk '{ t = $2 - $1; if (NR == 1 || t < best) best = t } END { printf "%.3f\n", best }'
+}
+
+printf "%-14s%12s%12s%12s%12s%10s\n" "input" "xlsx size" "xlsb size" "xlsx" "xlsb" "speedup"
+for f in bench/corpus/*.xlsx; do
+    name=$(basename "$f" .xlsx)
+    b=bench/corpus/$name.xlsb
+    [ -f "$b" ] || continue
+
+    tx=$(best_time "$(pwd)/$f" "$WORK_DIR/$name.xlsx")
+    tb=$(best_time "$(pwd)/$b" "$WORK_DIR/$name.xlsb")
+    if ! diff -r "$WORK_DIR/$name.xlsx" "$WORK_DIR/$name.xlsb" > /dev/null; then
+        echo "Error: $name: xlsx and xlsb outputs differ" >&2
+        exit 1
+    fi
+
+    echo "$name $(wc -c < "$f") $(wc -c < "$b") $tx $tb"
+done | awk '{
+    printf "%-14s%11.1fM%11.1fM%11.3fs%11.3fs%9.2fx\n", $1, $2 / 1048576, $3 / 1048576, $4, $5, $4 / $5
+    tx += $4; tb += $5
+} END { printf "%-14s%24s%11.3fs%11.3fs%9.2fx\n", "total", "", tx, tb, tx / tb }'
@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""Generate a deterministic XLSX corpus for PGO training and benchmarks.
+
+Usage: gen_corpus.py <output_dir> [scale] [name...]
+
+Each workbook is written as .xlsx and as an equivalent .xlsb (BIFF12).
+Workbooks cover the shapes that stress different parts of the converter:
+  wide.xlsx     - many columns per row (column bookkeeping in Filter;
+                  kept below MAX_COLUMNS since parse_worksheet pushes a
+                  separator cell between neighbouring cells)
+  long.xlsx     - many short numeric rows (worksheet scanning)
+  strings.xlsx  - large shared-string table (parse_shared_strings)
+  sparse.xlsx   - scattered cells with wide gaps (empty-column padding)
+  sheets.xlsx   - many small sheets (per-sheet open/flush overhead)
+"""
+import os
+import random
+import struct
+import sys
+import zipfile
+
+
+def col_name(index):
+    name = ""
+    index += 1
+    while index:
+        index, rem = divmod(index - 1, 26)
+        name = chr(65 + rem) + name
+    return name
+
+
+def xml_escape(text):
+    return text.replace("&", "&amp;").replace("<", "&lt;").replace(">", "&gt;")
+
+
+def num_text(value):
+    """Number as Excel writes it in <v>: shortest round-trip, no trailing .0"""
+    text = repr(value)
+    return text[:-2] if text.endswith(".0") else text
+
+
+# BIFF12 record types ([MS-XLSB] 2.3)
+BRT_ROW_HDR = 0
+BRT_CELL_RK = 2
+BRT_CELL_REAL = 5
+BRT_CELL_ISST = 7
+BRT_SST_ITEM = 19
+BRT_BEGIN_SHEET = 129
+BRT_END_SHEET = 130
+BRT_BEGIN_BOOK = 131
+BRT_END_BOOK = 132
+BRT_BEGIN_BUNDLE_SHS = 143
+BRT_END_BUNDLE_SHS = 144
+BRT_BEGIN_SHEET_DATA = 145
+BRT_END_SHEET_DATA = 146
+BRT_BUNDLE_SH = 156
+BRT_BEGIN_SST = 159
+BRT_END_SST = 160
+
+
+def varint(value, max_bytes):
+    out = bytearray()
+    for _ in range(max_bytes):
+        byte = value & 0x7F
+        value >>= 7
+        out.append(byte | (0x80 if value else 0))
+        if not value:
+            break
+    return bytes(out)
+
+
+def record(rtype, body=b""):
+    return varint(rtype, 2) + varint(len(body), 4) + body
+
+
+def wide_string(text):
+    data = text.encode("utf-16-le")
+    return struct.pack("<I", len(data) // 2) + data
+
+
+def cell(col, value, shared):
+    head = struct.pack("<II", col, 0)
+    if isinstance(value, str):
+        return record(BRT_CELL_ISST, head + struct.pack("<I", shared(value)))
+    if isinstance(value, int) and -(1 << 29) <= value < (1 << 29):
+        return record(BRT_CELL_RK, head + struct.pack("<I", ((value << 2) | 2) & 0xFFFFFFFF))
+    return record(BRT_CELL_REAL, head + struct.pack("<d", float(value)))
+
+
+class Workbook:
+    def __init__(self):
+        self.strings = []
+        self.string_index = {}
+        self.sheets = []
+        self.binary_sheets = []
+
+    def shared(self, text):
+        index = self.string_index.get(text)
+        if index is None:
+            index = len(self.strings)
+            self.string_index[text] = index
+            self.strings.append(text)
+        return index
+
+    def add_sheet(self, name, rows):
+        """rows: iterable of lists of (col, value) pairs; value str/int/float."""
+        rows = list(rows)
+        binary = [record(BRT_BEGIN_SHEET), record(BRT_BEGIN_SHEET_DATA)]
+        for r, cells in enumerate(rows):
+            binary.append(record(BRT_ROW_HDR, struct.pack("<IIHBBI", r, 0, 300, 0, 0, 0)))
+            binary.extend(cell(c, value, self.shared) for c, value in cells)
+        binary += [record(BRT_END_SHEET_DATA), record(BRT_END_SHEET)]
+        self.binary_sheets.append(b"".join(binary))
+
+        out = ['<?xml version="1.0" encoding="UTF-8" standalone="yes"?>\n'
+               '<worksheet xmlns="http://schemas.openxmlformats.org/spreadsheetml/2006/main"><sheetData>']
+        for r, cells in enumerate(rows):
+            out.append('<row r="%d">' % (r + 1))
+            for c, value in cells:
+                ref = col_name(c) + str(r + 1)
+                if isinstance(value, str):
+                    out.append('<c r="%s" t="s"><v>%d</v></c>' % (ref, self.shared(value)))
+                else:
+                    out.append('<c r="%s"><v>%s</v></c>' % (ref, num_text(value)))
+            out.append('</row>')
+        out.append('</sheetData></worksheet>')
+        self.sheets.append((name, "".join(out)))
+
+    def save(self, path):
+        with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as z:
+            sheets = "".join('<sheet name="%s" sheetId="%d" r:id="rId%d"/>' % (name, i + 1, i + 1)
+                             for i, (name, _) in enumerate(self.sheets))
+            z.writestr("xl/workbook.xml",
+                       '<?xml version="1.0" encoding="UTF-8" standalone="yes"?>\n'
+                       '<workbook xmlns="http://schemas.openxmlformats.org/spreadsheetml/2006/main" '
+                       'xmlns:r="http://schemas.openxmlformats.org/officeDocument/2006/relationships">'
+                       '<sheets>%s</sheets></workbook>' % sheets)
+            z.writestr("xl/sharedStrings.xml",
+                       '<?xml version="1.0" encoding="UTF-8" standalone="yes"?>\n'
+                       '<sst xmlns="http://schemas.openxmlformats.org/spreadsheetml/2006/main" '
+                       'count="%d" uniqueCount="%d">' % (len(self.strings), len(self.strings)) +
+                       "".join('<si><t>%s</t></si>' % xml_escape(s) for s in self.strings) +
+                       '</sst>')
+            for i, (_, xml) in enumerate(self.sheets):
+                z.writestr("xl/worksheets/sheet%d.xml" % (i + 1), xml)
+
+    def save_xlsb(self, path):
+        with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as z:
+            book = [record(BRT_BEGIN_BOOK), record(BRT_BEGIN_BUNDLE_SHS)]
+            for i, (name, _) in enumerate(self.sheets):
+                book.append(record(BRT_BUNDLE_SH, struct.pack("<II", 0, i + 1) +
+                                   wide_string("rId%d" % (i + 1)) + wide_string(name)))
+            book += [record(BRT_END_BUNDLE_SHS), record(BRT_END_BOOK)]
+            z.writestr("xl/workbook.bin", b"".join(book))
+
+            sst = [record(BRT_BEGIN_SST, struct.pack("<II", len(self.strings), len(self.strings)))]
+            sst.extend(record(BRT_SST_ITEM, b"\x00" + wide_string(s)) for s in self.strings)
+            sst.append(record(BRT_END_SST))
+            z.writestr("xl/sharedStrings.bin", b"".join(sst))
+
+            for i, data in enumerate(self.binary_sheets):
+                z.writestr("xl/worksheets/sheet%d.bin" % (i + 1), data)
+
+
+def header(names):
+    return [(i, name) for i, name in enumerate(names)]
+
+
+def gen_wide(rng, scale):
+    wb = Workbook()
+    cols = 400
+    rows = [header(["C%d" % i for i in range(cols)])]
+    for r in range(2000 * scale):
+        rows.append([(c, r * cols + c if c % 3 else "v%d" % (c % 50)) for c in range(cols)])
+    wb.add_sheet("Wide", rows)
+    return wb
+
+
+def gen_long(rng, scale):
+    wb = Workbook()
+    rows = [header(["ID", "Qty", "Price", "Ratio", "Code", "Flag"])]
+    for r in range(200000 * scale):
+        rows.append([(0, r), (1, rng.randint(0, 1000)), (2, round(rng.random() * 1e4, 2)),
+                     (3, rng.random()), (4, "C%03d" % rng.randint(0, 200)), (5, r & 1)])
+    wb.add_sheet("Long", rows)
+    return wb
+
+
+def gen_strings(rng, scale):
+    wb = Workbook()
+    words = ["alpha", "beta", "gamma", "delta", "<tag>", "R&D", "\"quoted\"", "tab\there", "x" * 40]
+    rows = [header(["Key", "Name", "Desc", "Note", "Region"])]
+    for r in range(60000 * scale):
+        rows.append([(0, "key-%d" % r),
+                     (1, "name %d %s" % (rng.randint(0, 10**6), rng.choice(words))),
+                     (2, " ".join(rng.choice(words) for _ in range(8))),
+                     (3, "note-%d" % rng.randint(0, 5000)),
+                     (4, rng.choice(["KR", "US", "JP", "DE", "FR"]))])
+    wb.add_sheet("Strings", rows)
+    return wb
+
+
+def gen_sparse(rng, scale):
+    wb = Workbook()
+    cols = 400
+    rows = [header(["S%d" % i for i in range(cols)])]
+    for r in range(20000 * scale):
+        picked = sorted(rng.sample(range(cols), 6))
+        rows.append([(c, rng.randint(0, 10**6) if c % 2 else "s%d" % c) for c in picked])
+    wb.add_sheet("Sparse", rows)
+    return wb
+
+
+def gen_sheets(rng, scale):
+    wb = Workbook()
+    for s in range(40):
+        rows = [header(["ID", "Value", "Label"])]
+        for r in range(2000 * scale):
+            rows.append([(0, r), (1, rng.random()), (2, "label%d" % rng.randint(0, 100))])
+        wb.add_sheet("Sheet_%02d" % s, rows)
+    return wb
+
+
+GENERATORS = {
+    "wide": gen_wide,
+    "long": gen_long,
+    "strings": gen_strings,
+    "sparse": gen_sparse,
+    "sheets": gen_sheets,
+}
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    out_dir = sys.argv[1]
+    scale = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+    names = sys.argv[3:] or list(GENERATORS)
+    os.makedirs(out_dir, exist_ok=True)
+    for name in names:
+        gen = GENERATORS[name]
+        path = os.path.join(out_dir, name + ".xlsx")
+        binary_path = os.path.join(out_dir, name + ".xlsb")
+        if os.path.exists(path) and os.path.exists(binary_path):
+            continue
+        wb = gen(random.Random(name), scale)
+        wb.save(path)
+        wb.save_xlsb(binary_path)
+        print("Generated %s, %s" % (path, binary_path))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
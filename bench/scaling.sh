@@ -0,0 +1,28 @@
+#!/bin/sh
+# Shared-strings parse time vs --threads on a large string-heavy workbook.
+# Usage: sh bench/scaling.sh   (SCALE=N to grow the table, RUNS=N repetitions)
+set -e
+cd "$(dirname "$0")/.."
+
+SCALE=${SCALE:-10}
+RUNS=${RUNS:-3}
+CORPUS=bench/corpus-scale$SCALE
+WORK_DIR=bench/bin/run
+
+python3 bench/gen_corpus.py "$CORPUS" "$SCALE" strings > /dev/null
+make -s
+mkdir -p "$WORK_DIR"
+
+printf "%8s %12s %9s\n" threads parse_ms speedup
+for t in 1 2 4 8 16; do
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        (cd "$WORK_DIR" && ../../../xlsx_to_tsv "../../../$CORPUS/strings.xlsx" --threads=$t) |
+            sed -n 's/^Loaded .* (\([0-9.]*\) ms.*/\1/p'
+        i=$((i + 1))
+    done | awk -v t=$t '
+        NR == 1 || $1 < best { best = $1 }
+        END { print t, best }'
+done | awk '
+    NR == 1 { base = $2 }
+    { printf "%8d %12.1f %8.2fx\n", $1, $2, base / $2 }'
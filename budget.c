@@ -0,0 +1,53 @@
+// *** BUDGET
+#include <limits.h>
+#include <time.h>
+
+#include "budget.h"
+
+// Cells between clock reads while a deadline is set
+#define BUDGET_CHECK_CELLS 4096
+
+_Thread_local Budget BUDGET = { 0, 0, 0, LLONG_MAX, BUDGET_OK };
+
+static double budget_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void budget_start(int deadline_ms, long long max_cells) {
+    BUDGET.deadline_ms = deadline_ms > 0 ? budget_now_ms() + deadline_ms : 0;
+    BUDGET.max_cells = max_cells > 0 ? max_cells : 0;
+    BUDGET.cells = 0;
+    BUDGET.stop = BUDGET_OK;
+    budget_check();
+}
+
+bool budget_check(void) {
+    if (BUDGET.stop == BUDGET_OK) {
+        if (BUDGET.max_cells > 0 && BUDGET.cells >= BUDGET.max_cells) {
+            BUDGET.stop = BUDGET_MAX_CELLS;
+        } else if (BUDGET.deadline_ms > 0 && budget_now_ms() >= BUDGET.deadline_ms) {
+            BUDGET.stop = BUDGET_DEADLINE;
+        }
+    }
+    if (BUDGET.stop != BUDGET_OK) {
+        BUDGET.next_check = 0;  // every later row checks (and fails) again
+        return true;
+    }
+
+    BUDGET.next_check = BUDGET.deadline_ms > 0 ? BUDGET.cells + BUDGET_CHECK_CELLS : LLONG_MAX;
+    if (BUDGET.max_cells > 0 && BUDGET.max_cells < BUDGET.next_check) {
+        BUDGET.next_check = BUDGET.max_cells;
+    }
+    return false;
+}
+
+const char* budget_stop_name(void) {
+    switch (BUDGET.stop) {
+        case BUDGET_DEADLINE: return "deadline";
+        case BUDGET_MAX_CELLS: return "max-cells";
+        default: return "none";
+    }
+}
+// *** BUDGET END
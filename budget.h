@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+
+// *** BUDGET
+// Limits of one conversion (--deadline, --max-cells). The worksheet parsers
+// count cells and check between rows, so a stopped sheet still ends with a
+// complete row; inflate and the shared-string parsers only poll the clock
+// every chunk. A worksheet whose inflate is cut short is still converted up
+// to its last complete row. Once a limit is hit every later check fails as
+// well, and the conversion closes what it has written and reports it as
+// truncated.
+
+typedef enum {
+    BUDGET_OK = 0,
+    BUDGET_DEADLINE,        // --deadline passed
+    BUDGET_MAX_CELLS,       // --max-cells worksheet cells read
+} BudgetStop;
+
+typedef struct {
+    double deadline_ms;     // CLOCK_MONOTONIC time in ms, 0 = none
+    long long max_cells;    // 0 = none
+    long long cells;        // worksheet cells read so far
+    long long next_check;   // cells at which budget_check runs again
+    BudgetStop stop;
+} Budget;
+
+// Per-thread like ALLOW_WILD_CARD, so --serve workers keep separate limits
+extern _Thread_local Budget BUDGET;
+
+// Reset for a new conversion; 0 disables a limit
+void budget_start(int deadline_ms, long long max_cells);
+// Check the limits now; true once the conversion has to stop
+bool budget_check(void);
+// Option name of the limit that stopped the conversion ("deadline", "max-cells")
+const char* budget_stop_name(void);
+
+// Count the cells of a finished row; true once the conversion has to stop
+static inline bool budget_add_cells(long long cells) {
+    BUDGET.cells += cells;
+    return BUDGET.cells >= BUDGET.next_check && budget_check();
+}
+
+// Clock-only checkpoint between chunks of other work
+static inline bool budget_poll(void) {
+    return (BUDGET.deadline_ms > 0 || BUDGET.stop != BUDGET_OK) && budget_check();
+}
+// *** BUDGET END
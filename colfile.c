@@ -0,0 +1,630 @@
+// *** COLFILE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "colfile.h"
+#include "numfmt.h"
+#include "hash.h"
+#include "fatal.h"
+
+// Roughly 1M cells per row group, within these bounds
+#define COLFILE_GROUP_CELLS (1 << 20)
+#define COLFILE_GROUP_MIN_ROWS 1024
+#define COLFILE_GROUP_MAX_ROWS 65536
+
+#define NO_ID UINT32_MAX
+
+// What a staged cell holds
+enum {
+    CELL_EMPTY = 0,
+    CELL_INT,           // int64, fits a DOUBLE chunk too (< 1e15)
+    CELL_WIDE_INT,      // int64 only
+    CELL_DOUBLE,        // formats back to its text
+    CELL_NUMBER_TEXT,   // double, but its text is kept too (57.0, 1E-05)
+    CELL_STRING,        // dictionary id
+};
+
+typedef struct {
+    uint8_t* kinds;             // per row of the current group
+    uint64_t* values;           // int64, double bits or string id
+    uint32_t* text_ids;         // CELL_NUMBER_TEXT: string id of the text
+} ColColumn;
+
+struct ColWriter {
+    ColWriteFn write;
+    void* user;
+    uint64_t offset;            // bytes written so far
+
+    int column_count;
+    char** names;
+    ColColumn* columns;
+    uint16_t* widths;
+    bool short_rows;            // some row of the group has fewer fields
+    int group_capacity;
+    int group_rows;
+
+    uint64_t* group_offsets;
+    uint32_t* group_row_counts;
+    int group_count;
+    int group_slots;
+
+    // Dictionary: string id i is text[ends[i - 1] .. ends[i])
+    char* text;
+    size_t text_len;
+    size_t text_capacity;
+    uint64_t* ends;
+    uint32_t string_count;
+    uint32_t string_capacity;
+    uint32_t* shared_ids;       // id per shared string, NO_ID = not added yet
+    int shared_count;
+    uint32_t* table;            // ids of other text by hash, NO_ID = empty
+    size_t table_mask;
+    size_t table_used;
+
+    unsigned char* chunk;       // payload of the chunk being written
+    size_t chunk_len;
+    size_t chunk_capacity;
+    uint64_t* scratch;          // packed values of a chunk
+};
+
+static void* col_alloc(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        fatal_error("Memory allocation failed");
+    }
+    return p;
+}
+
+static void* col_grow(void* p, size_t size) {
+    p = realloc(p, size);
+    if (!p) {
+        fatal_error("Memory allocation failed");
+    }
+    return p;
+}
+
+static void col_put(ColWriter* writer, const void* data, size_t len) {
+    writer->write(writer->user, data, len);
+    writer->offset += len;
+}
+
+static void col_put_u8(ColWriter* writer, uint8_t value) {
+    col_put(writer, &value, sizeof(value));
+}
+
+static void col_put_u32(ColWriter* writer, uint32_t value) {
+    col_put(writer, &value, sizeof(value));
+}
+
+static void col_put_u64(ColWriter* writer, uint64_t value) {
+    col_put(writer, &value, sizeof(value));
+}
+
+ColWriter* col_writer_create(ColWriteFn write, void* user, int string_count) {
+    ColWriter* writer = calloc(1, sizeof(ColWriter));
+    if (!writer) return NULL;
+    writer->write = write;
+    writer->user = user;
+    writer->shared_count = string_count;
+    writer->table_mask = 1023;
+    writer->table = col_alloc(sizeof(uint32_t) * (writer->table_mask + 1));
+    memset(writer->table, 0xFF, sizeof(uint32_t) * (writer->table_mask + 1));
+    return writer;
+}
+
+void col_writer_begin(ColWriter* writer, int column_count, char* const* names) {
+    // Zeroed first, so col_writer_free works after a failed allocation
+    writer->names = col_alloc(sizeof(char*) * column_count);
+    writer->columns = col_alloc(sizeof(ColColumn) * column_count);
+    memset(writer->names, 0, sizeof(char*) * column_count);
+    memset(writer->columns, 0, sizeof(ColColumn) * column_count);
+    writer->column_count = column_count;
+
+    int capacity = COLFILE_GROUP_CELLS / (column_count > 0 ? column_count : 1);
+    if (capacity < COLFILE_GROUP_MIN_ROWS) capacity = COLFILE_GROUP_MIN_ROWS;
+    if (capacity > COLFILE_GROUP_MAX_ROWS) capacity = COLFILE_GROUP_MAX_ROWS;
+    writer->group_capacity = capacity;
+    writer->widths = col_alloc(sizeof(uint16_t) * capacity);
+    writer->scratch = col_alloc(sizeof(uint64_t) * capacity);
+    for (int i = 0; i < column_count; i++) {
+        writer->names[i] = strdup(names[i]);
+        writer->columns[i].kinds = calloc(capacity, 1);
+        writer->columns[i].values = col_alloc(sizeof(uint64_t) * capacity);
+        writer->columns[i].text_ids = col_alloc(sizeof(uint32_t) * capacity);
+        if (!writer->names[i] || !writer->columns[i].kinds) {
+            fatal_error("Memory allocation failed");
+        }
+    }
+
+    uint32_t version = COLFILE_VERSION;
+    col_put(writer, COLFILE_MAGIC, 4);
+    col_put_u32(writer, version);
+}
+
+// *** dictionary
+
+static uint32_t dict_add(ColWriter* writer, const char* text, size_t len) {
+    if (writer->text_len + len > writer->text_capacity) {
+        size_t capacity = writer->text_capacity ? writer->text_capacity * 2 : 65536;
+        while (capacity < writer->text_len + len) capacity *= 2;
+        writer->text = col_grow(writer->text, capacity);
+        writer->text_capacity = capacity;
+    }
+    if (writer->string_count >= writer->string_capacity) {
+        writer->string_capacity = writer->string_capacity ? writer->string_capacity * 2 : 4096;
+        writer->ends = col_grow(writer->ends, sizeof(uint64_t) * writer->string_capacity);
+    }
+    memcpy(writer->text + writer->text_len, text, len);
+    writer->text_len += len;
+    writer->ends[writer->string_count] = writer->text_len;
+    return writer->string_count++;
+}
+
+static const char* dict_text(const ColWriter* writer, uint32_t id, size_t* len) {
+    uint64_t start = id > 0 ? writer->ends[id - 1] : 0;
+    *len = (size_t)(writer->ends[id] - start);
+    return writer->text + start;
+}
+
+// Id of a shared string, added on first use
+static uint32_t dict_shared_id(ColWriter* writer, int string_index, const char* text, size_t len) {
+    if (!writer->shared_ids) {
+        writer->shared_ids = col_alloc(sizeof(uint32_t) * writer->shared_count);
+        memset(writer->shared_ids, 0xFF, sizeof(uint32_t) * writer->shared_count);
+    }
+    uint32_t id = writer->shared_ids[string_index];
+    if (id == NO_ID) {
+        id = dict_add(writer, text, len);
+        writer->shared_ids[string_index] = id;
+    }
+    return id;
+}
+
+static void dict_table_insert(ColWriter* writer, uint32_t id) {
+    size_t len;
+    const char* text = dict_text(writer, id, &len);
+    size_t slot = hash64(text, len) & writer->table_mask;
+    while (writer->table[slot] != NO_ID) {
+        slot = (slot + 1) & writer->table_mask;
+    }
+    writer->table[slot] = id;
+}
+
+// Id of any other text: one entry per distinct text
+static uint32_t dict_text_id(ColWriter* writer, const char* text, size_t len) {
+    size_t slot = hash64(text, len) & writer->table_mask;
+    for (uint32_t id; (id = writer->table[slot]) != NO_ID; slot = (slot + 1) & writer->table_mask) {
+        size_t other_len;
+        const char* other = dict_text(writer, id, &other_len);
+        if (other_len == len && memcmp(other, text, len) == 0) return id;
+    }
+
+    uint32_t id = dict_add(writer, text, len);
+    writer->table[slot] = id;
+    if (++writer->table_used * 2 > writer->table_mask) {
+        // Load factor <= 1/2: rehash into twice the slots
+        uint32_t* old = writer->table;
+        size_t old_slots = writer->table_mask + 1;
+        writer->table_mask = old_slots * 2 - 1;
+        writer->table = col_alloc(sizeof(uint32_t) * old_slots * 2);
+        memset(writer->table, 0xFF, sizeof(uint32_t) * old_slots * 2);
+        for (size_t i = 0; i < old_slots; i++) {
+            if (old[i] != NO_ID) dict_table_insert(writer, old[i]);
+        }
+        free(old);
+    }
+    return id;
+}
+
+// *** cells
+
+// Integer text exactly as %lld prints it (no sign on 0, no leading zeros).
+// *small: below 1e15, where format_number prints the double back the same
+static bool parse_int_text(const char* s, size_t len, int64_t* value, bool* small) {
+    size_t i = s[0] == '-';
+    size_t digits = len - i;
+    if (digits == 0 || digits > 18 || (s[i] == '0' && (digits > 1 || i > 0))) return false;
+
+    int64_t v = 0;
+    for (; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    *value = s[0] == '-' ? -v : v;
+    *small = digits <= 15;
+    return true;
+}
+
+static size_t skip_digits(const char* s, size_t i, size_t len) {
+    while (i < len && s[i] >= '0' && s[i] <= '9') i++;
+    return i;
+}
+
+// Sign of mantissa * 10^exponent - bits * 2^binary_exponent, computed
+// exactly. Holds for mantissa < 2^60, bits < 2^55, exponent in -21..0 and
+// values in 1e-4..1e17.
+static int compare_decimal(uint64_t mantissa, int exponent, uint64_t bits, int binary_exponent) {
+    // mantissa * 2^-binary_exponent vs bits * 10^-exponent
+    unsigned __int128 left = mantissa, right = bits;
+    for (int i = exponent; i < 0; i++) right *= 10;
+    if (binary_exponent < 0) {
+        left <<= -binary_exponent;
+    } else {
+        right <<= binary_exponent;
+    }
+    return left < right ? -1 : left > right;
+}
+
+// Does mantissa * 10^exponent read as the double bits * 2^binary_exponent?
+// strtod rounds to nearest, ties to an even bits.
+static bool decimal_reads_as(uint64_t mantissa, int exponent, uint64_t bits, int binary_exponent) {
+    // Halfway to the next double up, and down (closer below a power of two)
+    int above = compare_decimal(mantissa, exponent, 2 * bits + 1, binary_exponent - 1);
+    int below = bits == 1ULL << 52 ? compare_decimal(mantissa, exponent, 4 * bits - 1, binary_exponent - 2)
+                                    : compare_decimal(mantissa, exponent, 2 * bits - 1, binary_exponent - 1);
+    bool even = (bits & 1) == 0;
+    return (above < 0 || (above == 0 && even)) && (below > 0 || (below == 0 && even));
+}
+
+// Is the plain decimal mantissa * 10^exponent (16 or 17 significant
+// digits, the last one not 0) what format_number prints for magnitude, the
+// double it reads as? Yes if no decimal with a digit less reads as
+// magnitude (the nearest shorter ones on either side do not, and the ones
+// that do form an interval around it) and magnitude lies strictly between
+// the midpoints to its neighbours, so it is also what printf rounds to.
+// All exact integer comparisons: strtod of near-halfway text is slow.
+// -1: magnitude is a midpoint and only formatting can tell.
+static int long_decimal_canonical(uint64_t mantissa, int exponent, double magnitude) {
+    int binary_exponent = 0;
+    double fraction = frexp(magnitude, &binary_exponent);
+    uint64_t bits = (uint64_t)ldexp(fraction, 53);
+    binary_exponent -= 53;
+
+    uint64_t shorter = mantissa / 10;
+    if (decimal_reads_as(shorter, exponent + 1, bits, binary_exponent) ||
+        decimal_reads_as(shorter + 1, exponent + 1, bits, binary_exponent)) {
+        return 0;
+    }
+
+    int above = compare_decimal(mantissa * 10 + 5, exponent - 1, bits, binary_exponent);
+    int below = compare_decimal(mantissa * 10 - 5, exponent - 1, bits, binary_exponent);
+    if (above == 0 || below == 0) return -1;
+    return above > 0 && below < 0;
+}
+
+static double strtod_text(const char* s, size_t len) {
+    char buf[64];
+    if (len >= sizeof(buf)) return NAN;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    return strtod(buf, NULL);
+}
+
+// Decimal number text (-?D[.D][e[+-]D]) and the double it reads as.
+// *canonical: format_number prints that double back as exactly this text.
+// A plain decimal with no trailing zero and an exponent in format_number's
+// plain range is the shortest text of its double if it has <= 15
+// significant digits; with 16 or 17 long_decimal_canonical decides. Other
+// texts are formatted to find out.
+static bool parse_number_text(const char* s, size_t len, double* value, bool* canonical) {
+    size_t int_start = s[0] == '-';
+    size_t i = skip_digits(s, int_start, len);
+    size_t int_digits = i - int_start;
+    size_t frac_start = i, frac_end = i;
+    if (int_digits == 0) return false;
+    if (i < len && s[i] == '.') {
+        frac_start = i + 1;
+        frac_end = i = skip_digits(s, frac_start, len);
+        if (frac_end == frac_start) return false;
+    }
+    bool exponent = i < len && (s[i] == 'e' || s[i] == 'E');
+    if (exponent) {
+        i++;
+        if (i < len && (s[i] == '+' || s[i] == '-')) i++;
+        size_t exp_start = i;
+        i = skip_digits(s, i, len);
+        if (i == exp_start) return false;
+    }
+
+    if (i != len) return false;
+
+    // A plain decimal with <= 15 significant digits and <= 22 fraction
+    // digits is an exact integer over an exact power of ten, so one
+    // division rounds it correctly (no strtod needed)
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    int plain = -1;
+    *value = NAN;
+    if (!exponent && frac_end > frac_start && s[frac_end - 1] != '0' && int_digits <= 16 &&
+        (int_digits == 1 || s[int_start] != '0')) {
+        // Significant digits: the integer part unless it is 0, then the
+        // fraction without leading zeros
+        size_t count = s[int_start] != '0' ? int_digits : 0;
+        size_t from = frac_start;
+        if (count == 0) {
+            while (s[from] == '0') from++;
+        }
+        size_t zeros = from - frac_start;
+        size_t total = count + (frac_end - from);
+        size_t fraction = frac_end - frac_start;
+
+        uint64_t mantissa = 0;
+        if (total <= 17) {
+            for (size_t j = 0; j < count; j++) mantissa = mantissa * 10 + (uint64_t)(s[int_start + j] - '0');
+            for (size_t j = from; j < frac_end; j++) mantissa = mantissa * 10 + (uint64_t)(s[j] - '0');
+        }
+        if (total <= 15 && fraction <= 22) {
+            *value = (double)mantissa / powers_of_ten[fraction];
+            if (int_start) *value = -*value;
+        }
+
+        if (zeros > 3 || total > 17) {
+            plain = 0;      // below 1e-4 format_number uses 1e-05; it never needs 18 digits
+        } else if (total <= 15) {
+            plain = 1;
+        } else {
+            *value = strtod_text(s, len);
+            plain = long_decimal_canonical(mantissa, -(int)fraction, fabs(*value));
+        }
+    }
+    if (isnan(*value)) *value = strtod_text(s, len);
+    if (!isfinite(*value)) return false;
+    if (plain >= 0) {
+        *canonical = plain;
+        return true;
+    }
+    char out[32];
+    format_number(*value, out);
+    *canonical = strlen(out) == len && memcmp(out, s, len) == 0;
+    return true;
+}
+
+void col_writer_cell(ColWriter* writer, int column, const char* text, size_t len, int string_index) {
+    if (column >= writer->column_count || len == 0) return;
+    ColColumn* col = &writer->columns[column];
+    int row = writer->group_rows;
+
+    int64_t n;
+    double d;
+    bool small, canonical;
+    if (string_index >= 0 && string_index < writer->shared_count) {
+        col->kinds[row] = CELL_STRING;
+        col->values[row] = dict_shared_id(writer, string_index, text, len);
+    } else if (parse_int_text(text, len, &n, &small)) {
+        col->kinds[row] = small ? CELL_INT : CELL_WIDE_INT;
+        col->values[row] = (uint64_t)n;
+    } else if (parse_number_text(text, len, &d, &canonical)) {
+        col->kinds[row] = canonical ? CELL_DOUBLE : CELL_NUMBER_TEXT;
+        memcpy(&col->values[row], &d, sizeof(d));
+        if (!canonical) col->text_ids[row] = dict_text_id(writer, text, len);
+    } else {
+        col->kinds[row] = CELL_STRING;
+        col->values[row] = dict_text_id(writer, text, len);
+    }
+}
+
+// *** row groups
+
+// Room for len more payload bytes; the caller fills them
+static unsigned char* chunk_extend(ColWriter* writer, size_t len) {
+    if (writer->chunk_len + len > writer->chunk_capacity) {
+        size_t capacity = writer->chunk_capacity ? writer->chunk_capacity * 2 : 65536;
+        while (capacity < writer->chunk_len + len) capacity *= 2;
+        writer->chunk = col_grow(writer->chunk, capacity);
+        writer->chunk_capacity = capacity;
+    }
+    unsigned char* p = writer->chunk + writer->chunk_len;
+    writer->chunk_len += len;
+    return p;
+}
+
+static void chunk_put(ColWriter* writer, const void* data, size_t len) {
+    memcpy(chunk_extend(writer, len), data, len);
+}
+
+// Bytes for values up to range (1..8)
+static uint8_t packed_width(uint64_t range) {
+    uint8_t width = 1;
+    while (width < 8 && (range >> (8 * width))) width++;
+    return width;
+}
+
+// Present values minus their minimum, in as few bytes each as the largest
+// needs: u64 base, u8 width, then width bytes per value
+static void chunk_put_packed(ColWriter* writer, const uint64_t* values, int count) {
+    uint64_t base = UINT64_MAX, top = 0;
+    for (int i = 0; i < count; i++) {
+        if (values[i] < base) base = values[i];
+        if (values[i] > top) top = values[i];
+    }
+    if (count == 0) base = 0;
+    uint8_t width = packed_width(top - base);
+    chunk_put(writer, &base, sizeof(base));
+    chunk_put(writer, &width, sizeof(width));
+    // 8 spare bytes so every value can be stored as a whole uint64_t
+    unsigned char* p = chunk_extend(writer, (size_t)count * width + 8);
+    for (int i = 0; i < count; i++) {
+        uint64_t delta = values[i] - base;
+        memcpy(p, &delta, sizeof(delta));
+        p += width;
+    }
+    writer->chunk_len -= 8;
+}
+
+// Text of a numeric cell in a DICT chunk: the same text the TSV has
+static uint32_t number_text_id(ColWriter* writer, const ColColumn* col, int row) {
+    char text[32];
+    if (col->kinds[row] == CELL_NUMBER_TEXT) return col->text_ids[row];
+    if (col->kinds[row] == CELL_DOUBLE) {
+        double d;
+        memcpy(&d, &col->values[row], sizeof(d));
+        format_number(d, text);
+    } else {
+        snprintf(text, sizeof(text), "%lld", (long long)(int64_t)col->values[row]);
+    }
+    return dict_text_id(writer, text, strlen(text));
+}
+
+static void col_write_chunk(ColWriter* writer, const ColColumn* col, int rows) {
+    bool strings = false, fractions = false;
+    int present = 0;
+    for (int i = 0; i < rows; i++) {
+        uint8_t kind = col->kinds[i];
+        if (kind == CELL_EMPTY) continue;
+        present++;
+        if (kind == CELL_STRING) strings = true;
+        if (kind == CELL_DOUBLE || kind == CELL_NUMBER_TEXT) fractions = true;
+    }
+    uint8_t encoding = present == 0 ? COLFILE_NULL
+                     : strings ? COLFILE_DICT
+                     : fractions ? COLFILE_DOUBLE
+                     : COLFILE_INT64;
+
+    writer->chunk_len = 0;
+    if (encoding != COLFILE_NULL) {
+        unsigned char* bitmap = chunk_extend(writer, ((size_t)rows + 7) / 8);
+        memset(bitmap, 0, ((size_t)rows + 7) / 8);
+        for (int i = 0; i < rows; i++) {
+            if (col->kinds[i] != CELL_EMPTY) bitmap[i / 8] |= (unsigned char)(1u << (i % 8));
+        }
+    }
+
+    uint64_t* packed = writer->scratch;
+    int count = 0;
+    if (encoding == COLFILE_INT64) {
+        // Offset from INT64_MIN so the packed order matches the numbers
+        for (int i = 0; i < rows; i++) {
+            if (col->kinds[i] != CELL_EMPTY) packed[count++] = col->values[i] ^ (1ULL << 63);
+        }
+        chunk_put_packed(writer, packed, count);
+    } else if (encoding == COLFILE_DICT) {
+        for (int i = 0; i < rows; i++) {
+            uint8_t kind = col->kinds[i];
+            if (kind == CELL_STRING) packed[count++] = col->values[i];
+            else if (kind != CELL_EMPTY) packed[count++] = number_text_id(writer, col, i);
+        }
+        chunk_put_packed(writer, packed, count);
+    } else if (encoding == COLFILE_DOUBLE) {
+        // Cells whose text is not format_number's are listed after the
+        // values as (row, string id) pairs
+        uint32_t exceptions = 0;
+        unsigned char* p = chunk_extend(writer, sizeof(double) * present);
+        for (int i = 0; i < rows; i++) {
+            uint8_t kind = col->kinds[i];
+            if (kind == CELL_EMPTY) continue;
+            double d;
+            if (kind == CELL_INT || kind == CELL_WIDE_INT) {
+                d = (double)(int64_t)col->values[i];
+            } else {
+                memcpy(&d, &col->values[i], sizeof(d));
+            }
+            memcpy(p, &d, sizeof(d));
+            p += sizeof(d);
+            if (kind == CELL_NUMBER_TEXT || kind == CELL_WIDE_INT) exceptions++;
+        }
+        chunk_put(writer, &exceptions, sizeof(exceptions));
+        for (int i = 0; i < rows; i++) {
+            uint8_t kind = col->kinds[i];
+            if (kind != CELL_NUMBER_TEXT && kind != CELL_WIDE_INT) continue;
+            uint32_t pair[2] = { (uint32_t)i, number_text_id(writer, col, i) };
+            chunk_put(writer, pair, sizeof(pair));
+        }
+    }
+
+    col_put_u8(writer, encoding);
+    col_put_u64(writer, writer->chunk_len);
+    col_put(writer, writer->chunk, writer->chunk_len);
+}
+
+static void col_write_group(ColWriter* writer) {
+    int rows = writer->group_rows;
+    if (rows == 0) return;
+
+    if (writer->group_count >= writer->group_slots) {
+        writer->group_slots = writer->group_slots ? writer->group_slots * 2 : 64;
+        writer->group_offsets = col_grow(writer->group_offsets, sizeof(uint64_t) * writer->group_slots);
+        writer->group_row_counts = col_grow(writer->group_row_counts, sizeof(uint32_t) * writer->group_slots);
+    }
+    writer->group_offsets[writer->group_count] = writer->offset;
+    writer->group_row_counts[writer->group_count] = (uint32_t)rows;
+    writer->group_count++;
+
+    col_put_u32(writer, (uint32_t)rows);
+    col_put_u8(writer, writer->short_rows);
+    if (writer->short_rows) col_put(writer, writer->widths, sizeof(uint16_t) * rows);
+    for (int i = 0; i < writer->column_count; i++) {
+        col_write_chunk(writer, &writer->columns[i], rows);
+        memset(writer->columns[i].kinds, CELL_EMPTY, rows);
+    }
+    writer->group_rows = 0;
+    writer->short_rows = false;
+}
+
+void col_writer_end_row(ColWriter* writer, int width) {
+    if (width > writer->column_count) width = writer->column_count;
+    writer->widths[writer->group_rows] = (uint16_t)width;
+    if (width < writer->column_count) writer->short_rows = true;
+    if (++writer->group_rows == writer->group_capacity) col_write_group(writer);
+}
+
+void col_writer_finish(ColWriter* writer) {
+    col_write_group(writer);
+
+    uint64_t footer = writer->offset;
+    col_put_u32(writer, (uint32_t)writer->column_count);
+    for (int i = 0; i < writer->column_count; i++) {
+        uint32_t len = (uint32_t)strlen(writer->names[i]);
+        col_put_u32(writer, len);
+        col_put(writer, writer->names[i], len);
+    }
+    col_put_u32(writer, (uint32_t)writer->group_count);
+    for (int i = 0; i < writer->group_count; i++) {
+        col_put_u64(writer, writer->group_offsets[i]);
+        col_put_u32(writer, writer->group_row_counts[i]);
+    }
+    col_put_u32(writer, writer->string_count);
+    col_put_u64(writer, writer->text_len);
+    for (uint32_t i = 0; i < writer->string_count; i++) {
+        // Length as a varint: 7 bits per byte, high bit = more bytes follow
+        size_t len;
+        dict_text(writer, i, &len);
+        unsigned char varint[10];
+        int n = 0;
+        do {
+            varint[n++] = (unsigned char)((len & 0x7F) | (len > 0x7F ? 0x80 : 0));
+            len >>= 7;
+        } while (len);
+        col_put(writer, varint, n);
+    }
+    col_put(writer, writer->text, writer->text_len);
+
+    col_put_u64(writer, footer);
+    col_put(writer, COLFILE_MAGIC, 4);
+}
+
+void col_writer_free(ColWriter* writer) {
+    if (!writer) return;
+    for (int i = 0; i < writer->column_count; i++) {
+        free(writer->names[i]);
+        free(writer->columns[i].kinds);
+        free(writer->columns[i].values);
+        free(writer->columns[i].text_ids);
+    }
+    free(writer->names);
+    free(writer->columns);
+    free(writer->widths);
+    free(writer->group_offsets);
+    free(writer->group_row_counts);
+    free(writer->text);
+    free(writer->ends);
+    free(writer->shared_ids);
+    free(writer->table);
+    free(writer->chunk);
+    free(writer->scratch);
+    free(writer);
+}
+// *** COLFILE END
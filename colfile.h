@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// *** COLFILE
+// Columnar sheet output (--format=col, <Sheet>.xcol). All integers are
+// little-endian:
+//
+//   "XCOL" u32 version
+//   row group*:  u32 rows, u8 has_widths, [u16 width per row]
+//                per column: u8 encoding, u64 payload bytes, payload
+//   footer:      u32 columns, per column u32 len + name
+//                u32 groups, per group u64 offset + u32 rows
+//                u32 strings, u64 text bytes, varint length per string, text
+//   trailer:     u64 footer offset, "XCOL"
+//
+// Payloads start with a bitmap of the cells that are not empty (bit i of
+// byte i/8), followed by one value per such cell:
+//
+//   INT64   every cell is an integer: u64 base, u8 width, then width bytes
+//           per value of (value ^ 1 << 63) - base
+//   DOUBLE  every cell is a number: f64 per value, then u32 count and
+//           (u32 row, u32 string id) per cell whose text is not the one
+//           format_number prints (57.0, 1E-05, 16+ digit integers)
+//   DICT    anything else: string ids packed like INT64 (base, width)
+//
+// String ids index the file's dictionary, which holds each shared string
+// used by the sheet once, plus the distinct text of other cells. NULL
+// chunks (every cell empty) have no payload. Widths are only stored for
+// groups with rows shorter than the header (the TSV line has fewer
+// fields), so cells and widths together reproduce the TSV byte for byte.
+
+#define COLFILE_MAGIC "XCOL"
+#define COLFILE_VERSION 1
+
+enum {
+    COLFILE_NULL = 0,
+    COLFILE_INT64 = 1,
+    COLFILE_DOUBLE = 2,
+    COLFILE_DICT = 3,
+};
+
+// Receives the file bytes in order
+typedef void (*ColWriteFn)(void* user, const void* data, size_t len);
+
+typedef struct ColWriter ColWriter;
+
+// string_count: shared strings of the workbook (string_index range)
+ColWriter* col_writer_create(ColWriteFn write, void* user, int string_count);
+// Column names; writes the file header
+void col_writer_begin(ColWriter* writer, int column_count, char* const* names);
+// One non-header cell as it would appear in the TSV; string_index is its
+// shared string, -1 for other cells
+void col_writer_cell(ColWriter* writer, int column, const char* text, size_t len, int string_index);
+// width: fields in this row's TSV line
+void col_writer_end_row(ColWriter* writer, int width);
+// Last row group and the footer
+void col_writer_finish(ColWriter* writer);
+void col_writer_free(ColWriter* writer);
+// *** COLFILE END
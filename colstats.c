@@ -0,0 +1,254 @@
+// *** COLSTATS
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "colstats.h"
+#include "hash.h"
+#include "fatal.h"
+
+void colstats_init(ColumnStats* cs) {
+    memset(cs, 0, sizeof(*cs));
+    cs->all_int = true;
+    cs->all_numeric = true;
+    cs->all_date = true;
+    cs->hll = calloc(HLL_REGISTERS, 1);
+    if (!cs->hll) {
+        fatal_error("Memory allocation failed");
+    }
+}
+
+void colstats_free(ColumnStats* cs) {
+    free(cs->str_min);
+    free(cs->str_max);
+    free(cs->hll);
+    memset(cs, 0, sizeof(*cs));
+}
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Exact powers of ten: a mantissa up to 2^53 multiplied or divided by one
+// is rounded once, so it reads as what strtod returns (Clinger's fast path)
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// 0 = not a number, 1 = integer, 2 = decimal/exponent.
+// Digits are accumulated into an integer mantissa and a decimal exponent;
+// only values outside the fast path (more than 19 digits, mantissa above
+// 2^53, exponent beyond 10^22) go to strtod.
+static int classify_number(const char* s, size_t len, double* value) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < len && (s[i] == '-' || s[i] == '+')) negative = s[i++] == '-';
+
+    size_t digits = 0;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+        if (digits < 19) mantissa = mantissa * 10 + (uint64_t)(s[i] - '0');
+        else exponent++;
+    }
+    int kind = 1;
+    if (i < len && s[i] == '.') {
+        kind = 2;
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(s[i] - '0');
+                exponent--;
+            }
+        }
+    }
+    if (!digits) return 0;
+
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        kind = 2;
+        i++;
+        bool exp_negative = false;
+        if (i < len && (s[i] == '-' || s[i] == '+')) exp_negative = s[i++] == '-';
+        size_t exp_start = i;
+        int exp_value = 0;
+        for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+            if (exp_value < 100000) exp_value = exp_value * 10 + (s[i] - '0');
+        }
+        if (i == exp_start) return 0;
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+    if (i != len) return 0;
+
+    if (digits <= 19 && (exponent == 0 || (mantissa <= 1ULL << 53 && exponent >= -22 && exponent <= 22))) {
+        double v = (double)mantissa;  // rounded once, like strtod
+        if (exponent < 0) v /= powers_of_ten[-exponent];
+        else if (exponent > 0) v *= powers_of_ten[exponent];
+        *value = negative ? -v : v;
+    } else {
+        *value = strtod(s, NULL);
+    }
+    return kind;
+}
+
+// YYYY-MM-DD, optionally followed by [T ]HH:MM[:SS[.fff]]
+static bool looks_like_date(const char* s, size_t len) {
+    if (len < 10) return false;
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 7) {
+            if (s[i] != '-') return false;
+        } else if (!is_digit(s[i])) {
+            return false;
+        }
+    }
+    if (len == 10) return true;
+    if ((s[10] != 'T' && s[10] != ' ') || len < 16) return false;
+    if (!is_digit(s[11]) || !is_digit(s[12]) || s[13] != ':' || !is_digit(s[14]) || !is_digit(s[15])) {
+        return false;
+    }
+    for (size_t i = 16; i < len; i++) {
+        if (!is_digit(s[i]) && s[i] != ':' && s[i] != '.') return false;
+    }
+    return true;
+}
+
+// First 8 bytes as a big-endian integer, zero padded: comparing keys orders
+// values like strcmp does up to the 8th byte
+static inline uint64_t prefix_key(const char* s, size_t len) {
+    uint64_t key = 0;
+    if (len >= 8) {
+        memcpy(&key, s, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        key = __builtin_bswap64(key);
+#endif
+        return key;
+    }
+    for (size_t i = 0; i < len; i++) {
+        key = (key << 8) | (unsigned char)s[i];
+    }
+    return key << (8 * (8 - len));
+}
+
+static void replace_string(char** slot, size_t* cap, const char* value, size_t len) {
+    if (len + 1 > *cap) {
+        size_t new_cap = len + 1 < 32 ? 32 : len + 1;
+        char* grown = realloc(*slot, new_cap);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        *slot = grown;
+        *cap = new_cap;
+    }
+    memcpy(*slot, value, len + 1);
+}
+
+void colstats_add(ColumnStats* cs, const char* value, size_t len) {
+    if (len == 0) return;  // empty cells are counted as nulls at write time
+
+    // Key and hash once per cell. A short value is its key and length, so a
+    // repeat of the previous one (flags, codes, sorted columns) changes
+    // nothing but the count.
+    uint64_t key = prefix_key(value, len);
+    if (len <= 8) {
+        if (len == cs->last_len && key == cs->last_key) {
+            cs->non_empty++;
+            return;
+        }
+        cs->last_key = key;
+        cs->last_len = len;
+    }
+    uint64_t h = len <= 8 ? hash64_mix(key ^ (len * 0x9e3779b97f4a7c15ULL)) : hash64(value, len);
+
+    if (cs->all_numeric) {
+        double v;
+        int kind = classify_number(value, len, &v);
+        if (kind == 0) {
+            cs->all_numeric = false;
+            cs->all_int = false;
+        } else {
+            if (kind == 2) cs->all_int = false;
+            if (cs->non_empty == 0 || v < cs->num_min) cs->num_min = v;
+            if (cs->non_empty == 0 || v > cs->num_max) cs->num_max = v;
+        }
+    }
+    if (cs->all_date && !looks_like_date(value, len)) {
+        cs->all_date = false;
+    }
+
+    // Prefix keys settle min/max without strcmp unless the first 8 bytes tie
+    if (!cs->str_min || key < cs->str_min_key || (key == cs->str_min_key && strcmp(value, cs->str_min) < 0)) {
+        replace_string(&cs->str_min, &cs->str_min_cap, value, len);
+        cs->str_min_key = key;
+    }
+    if (!cs->str_max || key > cs->str_max_key || (key == cs->str_max_key && strcmp(value, cs->str_max) > 0)) {
+        replace_string(&cs->str_max, &cs->str_max_cap, value, len);
+        cs->str_max_key = key;
+    }
+    if (len > cs->max_length) cs->max_length = len;
+
+    // HyperLogLog: top bits pick the register, rank of the rest is stored
+    uint32_t reg = (uint32_t)(h >> (64 - HLL_PRECISION));
+    uint64_t rest = (h << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+    uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+    if (rank > cs->hll[reg]) cs->hll[reg] = rank;
+
+    cs->non_empty++;
+}
+
+double colstats_distinct(const ColumnStats* cs) {
+    double m = HLL_REGISTERS;
+    double sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -cs->hll[i]);
+        if (cs->hll[i] == 0) zeros++;
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / zeros);  // linear counting for small cardinalities
+    }
+    return estimate;
+}
+
+static void write_json_string(FILE* fp, const char* s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void colstats_write_json(FILE* fp, const char* name, const ColumnStats* cs, long long rows) {
+    const char* type = "string";
+    if (cs->non_empty == 0) type = "empty";
+    else if (cs->all_int) type = "int";
+    else if (cs->all_numeric) type = "float";
+    else if (cs->all_date) type = "date";
+
+    fprintf(fp, "    {\"name\": ");
+    write_json_string(fp, name);
+    fprintf(fp, ", \"type\": \"%s\", \"nulls\": %lld", type, rows - cs->non_empty);
+
+    if (cs->non_empty > 0 && cs->all_numeric) {
+        fprintf(fp, ", \"min\": %.15g, \"max\": %.15g", cs->num_min, cs->num_max);
+    } else if (cs->non_empty > 0) {
+        fprintf(fp, ", \"min\": ");
+        write_json_string(fp, cs->str_min);
+        fprintf(fp, ", \"max\": ");
+        write_json_string(fp, cs->str_max);
+    } else {
+        fprintf(fp, ", \"min\": null, \"max\": null");
+    }
+
+    fprintf(fp, ", \"max_length\": %zu, \"distinct\": %.0f}", cs->max_length,
+            cs->non_empty > 0 ? colstats_distinct(cs) : 0.0);
+}
+// *** COLSTATS END
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// *** COLSTATS
+// Single-pass per-column statistics gathered while cells go through Filter
+// (--profile-columns). Distinct counts use a HyperLogLog sketch; 2^10
+// registers (~3% error) keep wide sheets' sketches inside L2.
+
+#define HLL_PRECISION 10
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+
+typedef struct {
+    long long non_empty;
+    bool all_int;           // every non-empty value so far is an integer
+    bool all_numeric;       // ... is an integer or decimal number
+    bool all_date;          // ... looks like YYYY-MM-DD[ HH:MM[:SS]]
+    double num_min;
+    double num_max;
+    char* str_min;          // lexicographic min/max (used for date/string)
+    char* str_max;
+    uint64_t str_min_key;   // first 8 bytes of str_min/str_max, big-endian
+    uint64_t str_max_key;
+    size_t str_min_cap;
+    size_t str_max_cap;
+    size_t max_length;
+    uint64_t last_key;      // previous value if it was 8 bytes or shorter
+    size_t last_len;        // (0 = none)
+    uint8_t* hll;
+} ColumnStats;
+
+void colstats_init(ColumnStats* cs);
+void colstats_free(ColumnStats* cs);
+void colstats_add(ColumnStats* cs, const char* value, size_t len);
+double colstats_distinct(const ColumnStats* cs);
+// Write one column as a JSON object; rows = data rows seen by the sheet
+void colstats_write_json(FILE* fp, const char* name, const ColumnStats* cs, long long rows);
+// *** COLSTATS END
@@ -0,0 +1,546 @@
+// *** EXTSORT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "extsort.h"
+#include "fatal.h"
+
+#define EXTSORT_CHUNK_SIZE (4 * 1024 * 1024)
+#define EXTSORT_SLICE_ROWS 16384    // rows per slice; slices stay cache-resident while sorted
+#define EXTSORT_MAX_THREADS 64
+#define EXTSORT_MAX_SLICES 256
+// Runs merged at once; past this, spilled runs are merged in several
+// passes so the open run files stay well below the descriptor limit
+#ifndef EXTSORT_MAX_FAN_IN
+#define EXTSORT_MAX_FAN_IN 64
+#endif
+
+typedef struct {
+    uint32_t seq;           // input order, breaks ties
+    uint32_t len;           // row bytes after the keys
+    uint16_t key_count;
+    uint16_t tag;
+    ExtSortKey keys[];
+} ExtSortRecord;
+
+typedef struct {
+    FILE* fp;               // NULL: the in-memory run
+    ExtSortRecord* record;  // current record
+    char* buf;              // file runs read each record here
+    size_t buf_capacity;
+    size_t next;            // in-memory run: next index
+} MergeSource;
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaChunk;
+
+struct ExtSort {
+    int key_count;
+    size_t budget;
+    int threads;
+    char* spill_prefix;
+    uint32_t next_seq;
+
+    // Current run: records live in the arena chunks, records[] is sorted
+    ArenaChunk* first_chunk;
+    ArenaChunk* chunk;
+    size_t run_bytes;       // arena and index bytes used by the run
+    ExtSortRecord** records;
+    size_t count;
+    size_t capacity;
+
+    FILE** runs;            // spilled runs, rewound for reading
+    int* run_levels;        // merge passes behind each run (0 = spilled)
+    int run_count;
+    int run_capacity;
+    int spilled_runs;       // runs spilled from memory
+    int spilled_files;      // spill files created, for unique names
+
+    // Merge in progress; extsort_free releases it if an error cut it short
+    MergeSource* merge_sources;
+    MergeSource** merge_heap;
+    int merge_source_count;
+    FILE* merge_output;     // run being merged into
+};
+
+static inline const char* record_row(const ExtSortRecord* record) {
+    return (const char*)(record->keys + record->key_count);
+}
+
+static inline size_t record_size(const ExtSortRecord* record) {
+    return sizeof(ExtSortRecord) + sizeof(ExtSortKey) * record->key_count + record->len;
+}
+
+static int record_compare(const ExtSortRecord* a, const ExtSortRecord* b) {
+    const char* row_a = record_row(a);
+    const char* row_b = record_row(b);
+    for (int i = 0; i < a->key_count; i++) {
+        const ExtSortKey* key_a = &a->keys[i];
+        const ExtSortKey* key_b = &b->keys[i];
+        if (key_a->rank != EXTSORT_NO_RANK && key_b->rank != EXTSORT_NO_RANK) {
+            if (key_a->rank != key_b->rank) return key_a->rank < key_b->rank ? -1 : 1;
+            continue;
+        }
+        uint32_t len = key_a->len < key_b->len ? key_a->len : key_b->len;
+        int c = memcmp(row_a + key_a->offset, row_b + key_b->offset, len);
+        if (c != 0) return c;
+        if (key_a->len != key_b->len) return key_a->len < key_b->len ? -1 : 1;
+    }
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+static int record_compare_ptr(const void* a, const void* b) {
+    return record_compare(*(ExtSortRecord* const*)a, *(ExtSortRecord* const*)b);
+}
+
+ExtSort* extsort_create(int key_count, size_t memory_budget, int threads, const char* spill_prefix) {
+    ExtSort* sort = calloc(1, sizeof(ExtSort));
+    if (!sort) return NULL;
+    sort->key_count = key_count < EXTSORT_MAX_KEYS ? key_count : EXTSORT_MAX_KEYS;
+    sort->budget = memory_budget;
+    sort->threads = threads < 1 ? 1 : threads > EXTSORT_MAX_THREADS ? EXTSORT_MAX_THREADS : threads;
+    sort->spill_prefix = strdup(spill_prefix);
+    if (!sort->spill_prefix) {
+        free(sort);
+        return NULL;
+    }
+    return sort;
+}
+
+// Chunks are kept across runs; a spilled run just rewinds them
+static void* arena_alloc(ExtSort* sort, size_t size) {
+    while (sort->chunk && sort->chunk->capacity - sort->chunk->used < size && sort->chunk->next) {
+        sort->chunk = sort->chunk->next;
+    }
+    if (!sort->chunk || sort->chunk->capacity - sort->chunk->used < size) {
+        size_t capacity = size > EXTSORT_CHUNK_SIZE ? size : EXTSORT_CHUNK_SIZE;
+        ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + capacity);
+        if (!chunk) {
+            fatal_error("Memory allocation failed");
+        }
+        chunk->next = NULL;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        if (sort->chunk) {
+            chunk->next = sort->chunk->next;
+            sort->chunk->next = chunk;
+        } else {
+            sort->first_chunk = chunk;
+        }
+        sort->chunk = chunk;
+    }
+    void* p = sort->chunk->data + sort->chunk->used;
+    sort->chunk->used += size;
+    return p;
+}
+
+static void arena_reset(ExtSort* sort) {
+    for (ArenaChunk* chunk = sort->first_chunk; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    sort->chunk = sort->first_chunk;
+}
+
+typedef struct {
+    ExtSortRecord** records;
+    size_t count;
+} SortPart;
+
+static void* sort_part(void* arg) {
+    SortPart* part = arg;
+    qsort(part->records, part->count, sizeof(ExtSortRecord*), record_compare_ptr);
+    return NULL;
+}
+
+typedef struct {
+    ExtSortRecord** a;
+    size_t a_count;
+    ExtSortRecord** b;
+    size_t b_count;
+    ExtSortRecord** out;
+} MergePart;
+
+static void* merge_part(void* arg) {
+    MergePart* part = arg;
+    size_t i = 0, j = 0, k = 0;
+    while (i < part->a_count && j < part->b_count) {
+        part->out[k++] = record_compare(part->a[i], part->b[j]) <= 0 ? part->a[i++] : part->b[j++];
+    }
+    while (i < part->a_count) part->out[k++] = part->a[i++];
+    while (j < part->b_count) part->out[k++] = part->b[j++];
+    return NULL;
+}
+
+typedef struct {
+    void* (*fn)(void*);
+    char* args;
+    size_t arg_size;
+    int count;
+    int first;
+    int stride;
+} ParallelJob;
+
+static void* parallel_worker(void* arg) {
+    ParallelJob* job = arg;
+    for (int i = job->first; i < job->count; i += job->stride) {
+        job->fn(job->args + job->arg_size * i);
+    }
+    return NULL;
+}
+
+// Run fn over count args on up to threads threads (including this one)
+static void run_parallel(void* (*fn)(void*), void* args, size_t arg_size, int count, int threads) {
+    if (threads > count) threads = count;
+    if (threads < 1) threads = 1;
+    pthread_t ids[EXTSORT_MAX_THREADS];
+    ParallelJob jobs[EXTSORT_MAX_THREADS];
+    bool started[EXTSORT_MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        jobs[t] = (ParallelJob){ fn, args, arg_size, count, t, threads };
+    }
+    for (int t = 1; t < threads; t++) {
+        started[t] = pthread_create(&ids[t], NULL, parallel_worker, &jobs[t]) == 0;
+        if (!started[t]) parallel_worker(&jobs[t]);
+    }
+    parallel_worker(&jobs[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) pthread_join(ids[t], NULL);
+    }
+}
+
+// Sort records[] of the current run: cache-sized slices are sorted on the
+// worker threads, then merged pairwise (also in parallel) into one
+static void sort_records(ExtSort* sort) {
+    size_t n = sort->count;
+    size_t slices_needed = (n + EXTSORT_SLICE_ROWS - 1) / EXTSORT_SLICE_ROWS;
+    int parts = slices_needed > EXTSORT_MAX_SLICES ? EXTSORT_MAX_SLICES : (int)slices_needed;
+    if (parts <= 1) {
+        qsort(sort->records, n, sizeof(ExtSortRecord*), record_compare_ptr);
+        return;
+    }
+
+    ExtSortRecord** tmp = malloc(sizeof(ExtSortRecord*) * n);
+    if (!tmp) {
+        qsort(sort->records, n, sizeof(ExtSortRecord*), record_compare_ptr);
+        return;
+    }
+
+    size_t bounds[EXTSORT_MAX_SLICES + 1];
+    SortPart slices[EXTSORT_MAX_SLICES];
+    for (int i = 0; i <= parts; i++) {
+        bounds[i] = n * (size_t)i / (size_t)parts;
+    }
+    for (int i = 0; i < parts; i++) {
+        slices[i] = (SortPart){ sort->records + bounds[i], bounds[i + 1] - bounds[i] };
+    }
+    run_parallel(sort_part, slices, sizeof(SortPart), parts, sort->threads);
+
+    ExtSortRecord** src = sort->records;
+    ExtSortRecord** dst = tmp;
+    while (parts > 1) {
+        MergePart merges[EXTSORT_MAX_SLICES / 2];
+        int pairs = parts / 2;
+        for (int i = 0; i < pairs; i++) {
+            size_t lo = bounds[2 * i], mid = bounds[2 * i + 1], hi = bounds[2 * i + 2];
+            merges[i] = (MergePart){ src + lo, mid - lo, src + mid, hi - mid, dst + lo };
+        }
+        run_parallel(merge_part, merges, sizeof(MergePart), pairs, sort->threads);
+        if (parts % 2) {
+            size_t lo = bounds[parts - 1];
+            memcpy(dst + lo, src + lo, sizeof(ExtSortRecord*) * (n - lo));
+        }
+
+        for (int i = 0; i <= pairs; i++) {
+            bounds[i] = bounds[2 * i < parts ? 2 * i : parts];
+        }
+        parts = (parts + 1) / 2;
+        bounds[parts] = n;
+        ExtSortRecord** swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != sort->records) memcpy(sort->records, src, sizeof(ExtSortRecord*) * n);
+    free(tmp);
+}
+
+static FILE* open_spill_file(ExtSort* sort) {
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s.sort%05d.tmp", sort->spill_prefix, sort->spilled_files);
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        fatal_error("Could not create sort run %s: %s", filename, strerror(errno));
+    }
+    // The run lives only as long as the descriptor
+    unlink(filename);
+    FILE* fp = fdopen(fd, "w+b");
+    if (!fp) {
+        close(fd);
+        fatal_error("Could not create sort run %s: %s", filename, strerror(errno));
+    }
+    sort->spilled_files++;
+    return fp;
+}
+
+static void write_record(FILE* fp, const ExtSortRecord* record) {
+    if (fwrite(record, record_size(record), 1, fp) != 1) {
+        fatal_error("Could not write sort run: %s", strerror(errno));
+    }
+}
+
+// Rewind a finished run for reading
+static void finish_run_file(FILE* fp) {
+    if (fflush(fp) != 0) {
+        fatal_error("Could not write sort run: %s", strerror(errno));
+    }
+    rewind(fp);
+}
+
+static bool source_next(ExtSort* sort, MergeSource* src) {
+    if (!src->fp) {
+        if (src->next >= sort->count) return false;
+        src->record = sort->records[src->next++];
+        return true;
+    }
+
+    ExtSortRecord header;
+    if (fread(&header, sizeof(header), 1, src->fp) != 1) {
+        if (ferror(src->fp)) {
+            fatal_error("Could not read sort run: %s", strerror(errno));
+        }
+        return false;
+    }
+    size_t size = record_size(&header);
+    if (size > src->buf_capacity) {
+        char* grown = realloc(src->buf, size);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        src->buf = grown;
+        src->buf_capacity = size;
+    }
+    memcpy(src->buf, &header, sizeof(header));
+    if (fread(src->buf + sizeof(header), size - sizeof(header), 1, src->fp) != 1) {
+        fatal_error("Could not read sort run: truncated");
+    }
+    src->record = (ExtSortRecord*)src->buf;
+    return true;
+}
+
+static void heap_sift_down(MergeSource** heap, int size, int i) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < size && record_compare(heap[left]->record, heap[smallest]->record) < 0) smallest = left;
+        if (right < size && record_compare(heap[right]->record, heap[smallest]->record) < 0) smallest = right;
+        if (smallest == i) return;
+        MergeSource* swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+// Merge runs[first..run_count) and, with_memory, the sorted in-memory run;
+// each record in key order goes to put
+static void free_merge_sources(ExtSort* sort) {
+    for (int i = 0; i < sort->merge_source_count; i++) {
+        free(sort->merge_sources[i].buf);
+    }
+    free(sort->merge_sources);
+    free(sort->merge_heap);
+    sort->merge_sources = NULL;
+    sort->merge_heap = NULL;
+    sort->merge_source_count = 0;
+}
+
+static void merge_runs(ExtSort* sort, int first, bool with_memory,
+                       void (*put)(void* user, const ExtSortRecord* record), void* user) {
+    int source_count = sort->run_count - first + (with_memory ? 1 : 0);
+    MergeSource* sources = calloc(source_count, sizeof(MergeSource));
+    MergeSource** heap = malloc(sizeof(MergeSource*) * source_count);
+    sort->merge_sources = sources;
+    sort->merge_heap = heap;
+    sort->merge_source_count = sources ? source_count : 0;
+    if (!sources || !heap) {
+        fatal_error("Memory allocation failed");
+    }
+    int heap_size = 0;
+    for (int i = 0; i < source_count; i++) {
+        sources[i].fp = first + i < sort->run_count ? sort->runs[first + i] : NULL;
+        if (source_next(sort, &sources[i])) heap[heap_size++] = &sources[i];
+    }
+    for (int i = heap_size / 2 - 1; i >= 0; i--) {
+        heap_sift_down(heap, heap_size, i);
+    }
+
+    while (heap_size > 0) {
+        MergeSource* top = heap[0];
+        put(user, top->record);
+        if (!source_next(sort, top)) heap[0] = heap[--heap_size];
+        heap_sift_down(heap, heap_size, 0);
+    }
+    free_merge_sources(sort);
+}
+
+static void put_to_file(void* user, const ExtSortRecord* record) {
+    write_record(user, record);
+}
+
+// Replace runs[first..run_count) by one run merged from them
+static void merge_tail_runs(ExtSort* sort, int first, int level) {
+    FILE* fp = open_spill_file(sort);
+    sort->merge_output = fp;
+    merge_runs(sort, first, false, put_to_file, fp);
+    finish_run_file(fp);
+    sort->merge_output = NULL;
+    for (int i = first; i < sort->run_count; i++) {
+        fclose(sort->runs[i]);
+    }
+    sort->runs[first] = fp;
+    sort->run_levels[first] = level;
+    sort->run_count = first + 1;
+}
+
+// Sort the current run and write it to a temporary file. Runs stack up by
+// level: EXTSORT_MAX_FAN_IN runs of one level merge into one of the next,
+// so every row is rewritten once per level (log base fan-in of the runs)
+static void spill_run(ExtSort* sort) {
+    sort_records(sort);
+
+    if (sort->run_count >= sort->run_capacity) {
+        int capacity = sort->run_capacity ? sort->run_capacity * 2 : 16;
+        FILE** runs = realloc(sort->runs, sizeof(FILE*) * capacity);
+        if (runs) sort->runs = runs;
+        int* levels = realloc(sort->run_levels, sizeof(int) * capacity);
+        if (levels) sort->run_levels = levels;
+        if (!runs || !levels) {
+            fatal_error("Memory allocation failed");
+        }
+        sort->run_capacity = capacity;
+    }
+    FILE* fp = open_spill_file(sort);
+    sort->runs[sort->run_count] = fp;
+    sort->run_levels[sort->run_count++] = 0;
+    sort->spilled_runs++;
+
+    for (size_t i = 0; i < sort->count; i++) {
+        write_record(fp, sort->records[i]);
+    }
+    finish_run_file(fp);
+
+    sort->count = 0;
+    sort->run_bytes = 0;
+    arena_reset(sort);
+
+    for (;;) {
+        int level = sort->run_levels[sort->run_count - 1];
+        int first = sort->run_count;
+        while (first > 0 && sort->run_levels[first - 1] == level) first--;
+        if (sort->run_count - first < EXTSORT_MAX_FAN_IN) break;
+        merge_tail_runs(sort, first, level + 1);
+    }
+}
+
+void extsort_add(ExtSort* sort, const char* head, size_t head_len, const char* body, size_t body_len,
+                 const ExtSortKey* keys, int tag) {
+    size_t size = sizeof(ExtSortRecord) + sizeof(ExtSortKey) * sort->key_count + head_len + body_len;
+    size = (size + 3) & ~(size_t)3;  // keep records 4-byte aligned
+    if (sort->count > 0 && sort->run_bytes + size + sizeof(ExtSortRecord*) > sort->budget) {
+        spill_run(sort);
+    }
+
+    if (sort->count >= sort->capacity) {
+        size_t capacity = sort->capacity ? sort->capacity * 2 : 4096;
+        ExtSortRecord** grown = realloc(sort->records, sizeof(ExtSortRecord*) * capacity);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        sort->records = grown;
+        sort->capacity = capacity;
+    }
+
+    ExtSortRecord* record = arena_alloc(sort, size);
+    record->seq = sort->next_seq++;
+    record->len = (uint32_t)(head_len + body_len);
+    record->key_count = (uint16_t)sort->key_count;
+    record->tag = (uint16_t)tag;
+    for (int i = 0; i < sort->key_count; i++) {
+        record->keys[i] = keys[i];
+        record->keys[i].offset += (uint32_t)head_len;
+    }
+    char* row = (char*)(record->keys + sort->key_count);
+    memcpy(row, head, head_len);
+    memcpy(row + head_len, body, body_len);
+
+    sort->records[sort->count++] = record;
+    sort->run_bytes += size + sizeof(ExtSortRecord*);
+}
+
+typedef struct {
+    ExtSortEmit emit;
+    void* user;
+} EmitTarget;
+
+static void put_to_emit(void* user, const ExtSortRecord* record) {
+    EmitTarget* target = user;
+    target->emit(target->user, record_row(record), record->len, record->tag);
+}
+
+// Emit every row in key order: the in-memory run directly, or a k-way
+// merge of the spilled runs and the in-memory run (after merging the
+// newest runs until at most EXTSORT_MAX_FAN_IN sources remain)
+void extsort_finish(ExtSort* sort, ExtSortEmit emit, void* user) {
+    sort_records(sort);
+    if (sort->run_count == 0) {
+        for (size_t i = 0; i < sort->count; i++) {
+            emit(user, record_row(sort->records[i]), sort->records[i]->len, sort->records[i]->tag);
+        }
+        sort->count = 0;
+        return;
+    }
+
+    while (sort->run_count + 1 > EXTSORT_MAX_FAN_IN) {
+        int first = sort->run_count - EXTSORT_MAX_FAN_IN;
+        if (first < 0) first = 0;
+        merge_tail_runs(sort, first, sort->run_levels[first] + 1);
+    }
+    EmitTarget target = { emit, user };
+    merge_runs(sort, 0, true, put_to_emit, &target);
+    sort->count = 0;
+}
+
+int extsort_spilled_runs(const ExtSort* sort) {
+    return sort->spilled_runs;
+}
+
+void extsort_free(ExtSort* sort) {
+    if (!sort) return;
+    free_merge_sources(sort);
+    if (sort->merge_output) fclose(sort->merge_output);
+    for (int i = 0; i < sort->run_count; i++) {
+        fclose(sort->runs[i]);
+    }
+    free(sort->runs);
+    free(sort->run_levels);
+    ArenaChunk* chunk = sort->first_chunk;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(sort->records);
+    free(sort->spill_prefix);
+    free(sort);
+}
+// *** EXTSORT END
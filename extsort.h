@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// *** EXTSORT
+// Memory-bounded external sort of output rows (--sort-by). Rows are copied
+// into arena chunks; when the memory budget is used up the run is sorted
+// (in parallel) and spilled to a temporary file next to the output. Every
+// EXTSORT_MAX_FAN_IN runs of a level are merged into one run of the next,
+// and at the end the remaining runs and the last in-memory run are k-way
+// merged.
+//
+// Keys compare by byte order of their text, like LC_ALL=C sort. A key that
+// came from a shared string also carries its collation rank (the string's
+// position in the byte order of all shared strings, equal strings sharing a
+// rank), so two such keys compare as integers. Ties keep input order.
+
+#define EXTSORT_MAX_KEYS 8
+#define EXTSORT_NO_RANK UINT32_MAX
+
+typedef struct {
+    uint32_t rank;          // EXTSORT_NO_RANK: compare the text
+    uint32_t offset;        // key text within the row
+    uint32_t len;
+} ExtSortKey;
+
+// Sorted rows in order; tag is the value given to extsort_add
+typedef void (*ExtSortEmit)(void* user, const char* row, size_t len, int tag);
+
+typedef struct ExtSort ExtSort;
+
+// Runs spill to <spill_prefix>.sortNNNNN.tmp (unlinked as soon as created)
+ExtSort* extsort_create(int key_count, size_t memory_budget, int threads, const char* spill_prefix);
+// Row = head followed by body; key offsets are relative to body
+void extsort_add(ExtSort* sort, const char* head, size_t head_len, const char* body, size_t body_len,
+                 const ExtSortKey* keys, int tag);
+void extsort_finish(ExtSort* sort, ExtSortEmit emit, void* user);
+int extsort_spilled_runs(const ExtSort* sort);
+void extsort_free(ExtSort* sort);
+// *** EXTSORT END
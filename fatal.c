@@ -0,0 +1,26 @@
+// *** FATAL
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fatal.h"
+
+_Thread_local FatalScope* FATAL_SCOPE = NULL;
+
+void fatal_error(const char* format, ...) {
+    char message[sizeof(FATAL_SCOPE->message)];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    FatalScope* scope = FATAL_SCOPE;
+    if (scope) {
+        FATAL_SCOPE = NULL;  // an error while the job is released is not caught again
+        snprintf(scope->message, sizeof(scope->message), "%s", message);
+        longjmp(scope->jump, 1);
+    }
+    printf("Error: %s\n", message);
+    exit(1);
+}
+// *** FATAL END
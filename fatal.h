@@ -0,0 +1,21 @@
+#pragma once
+
+#include <setjmp.h>
+
+// *** FATAL
+// Errors that end a whole conversion: a failed write, exhausted memory, a
+// sheet wider than MAX_COLUMNS. The command line prints "Error: ..." and
+// exits; a --serve worker sets FATAL_SCOPE around each job, so only that
+// job fails and the server keeps running.
+
+typedef struct {
+    jmp_buf jump;
+    char message[256];
+} FatalScope;
+
+// Per-thread like BUDGET; NULL outside a --serve job
+extern _Thread_local FatalScope* FATAL_SCOPE;
+
+// Longjmp to FATAL_SCOPE with the message, or print it and exit(1)
+_Noreturn void fatal_error(const char* format, ...) __attribute__((format(printf, 1, 2)));
+// *** FATAL END
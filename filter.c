@@ -2,7 +2,15 @@
 //#define _GNU_SOURCE  // GNU 확장 기능 활성화
 //#define _POSIX_C_SOURCE 200809L  // POSIX.1-2008 기능 활성화
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
 #include "filter.h"
+#include "uring_io.h"
+#include "hash.h"
+#include "fatal.h"
 
 // strdup 함수 프로토타입 명시적 선언
 //char* strdup(const char* s);
@@ -15,33 +23,365 @@ void filter_finish_line(Filter* filter);
 int is_valid_name(const char* name);
 */
 
-bool ALLOW_WILD_CARD = true;
+_Thread_local bool ALLOW_WILD_CARD = true;
+_Thread_local bool USE_IO_URING = false;
+
+_Static_assert(FILTER_BUFFER_SIZE <= URING_IO_BUFFER_SIZE, "filter buffer must fit a uring_io buffer");
+
+// Hand the current buffer to the kernel and start a fresh one
+static void writer_flush(FilterWriter* writer) {
+    if (writer->buf_len == 0) {
+        return;
+    }
+
+    if (USE_IO_URING) {
+        uring_io_submit(writer->fd, writer->buf, writer->buf_len, writer->offset);
+        writer->buf = NULL;  // the ring's now
+        writer->offset += writer->buf_len;
+        writer->buf_len = 0;
+        writer->buf = uring_io_get_buffer();
+        return;
+    }
+
+    size_t done = 0;
+    while (done < writer->buf_len) {
+        ssize_t n = write(writer->fd, writer->buf + done, writer->buf_len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fatal_error("write failed: %s", strerror(errno));
+        }
+        done += (size_t)n;
+    }
+    writer->offset += writer->buf_len;
+    writer->buf_len = 0;
+}
+
+static void writer_write(FilterWriter* writer, const char* data, size_t len) {
+    while (len > 0) {
+        size_t room = FILTER_BUFFER_SIZE - writer->buf_len;
+        size_t n = len < room ? len : room;
+        memcpy(writer->buf + writer->buf_len, data, n);
+        writer->buf_len += n;
+        data += n;
+        len -= n;
+        if (writer->buf_len == FILTER_BUFFER_SIZE) {
+            writer_flush(writer);
+        }
+    }
+}
+
+static inline void writer_putc(FilterWriter* writer, char c) {
+    if (writer->buf_len == FILTER_BUFFER_SIZE) {
+        writer_flush(writer);
+    }
+    writer->buf[writer->buf_len++] = c;
+}
+
+// Open the file for the writer's partition/shard:
+// <Sheet>.pNNNNN.tsv, <Sheet>.NNNNN.tsv or <Sheet>.pNNNNN.NNNNN.tsv
+static int writer_open(Filter* filter, FilterWriter* writer) {
+    char filename[PATH_MAX];
+    int stem = (int)strlen(filter->base_filename) - 4;  // without ".tsv"
+    if (filter->split_opts.partitions > 1 && filter->split_opts.shard_rows > 0) {
+        snprintf(filename, sizeof(filename), "%.*s.p%05d.%05d.tsv", stem, filter->base_filename,
+                 writer->partition, writer->shard);
+    } else if (filter->split_opts.partitions > 1) {
+        snprintf(filename, sizeof(filename), "%.*s.p%05d.tsv", stem, filter->base_filename, writer->partition);
+    } else {
+        snprintf(filename, sizeof(filename), "%.*s.%05d.tsv", stem, filter->base_filename, writer->shard);
+    }
+
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        return 0;
+    }
+    writer->offset = 0;
+    writer->rows = 0;
+    filter->file_count++;
+    return 1;
+}
+
+static void writer_close(FilterWriter* writer) {
+    writer_flush(writer);
+    if (USE_IO_URING) {
+        // Wait for in-flight writes before closing the descriptor
+        uring_io_drain();
+    }
+    close(writer->fd);
+    writer->fd = -1;
+    writer->bytes += writer->offset;
+    writer->offset = 0;
+}
+
+// Split sheets build each row in row_buf first
+static void filter_row_reserve(Filter* filter, size_t len) {
+    if (filter->row_len + len <= filter->row_capacity) {
+        return;
+    }
+    size_t capacity = filter->row_capacity ? filter->row_capacity * 2 : 4096;
+    while (capacity < filter->row_len + len) capacity *= 2;
+    char* grown = realloc(filter->row_buf, capacity);
+    if (!grown) {
+        fatal_error("Memory allocation failed");
+    }
+    filter->row_buf = grown;
+    filter->row_capacity = capacity;
+}
+
+static void filter_write(Filter* filter, const char* data, size_t len) {
+    if (filter->staged) {
+        filter_row_reserve(filter, len);
+        memcpy(filter->row_buf + filter->row_len, data, len);
+        filter->row_len += len;
+        return;
+    }
+    writer_write(&filter->writers[0], data, len);
+}
+
+static inline void filter_putc(Filter* filter, char c) {
+    if (filter->staged) {
+        filter_row_reserve(filter, 1);
+        filter->row_buf[filter->row_len++] = c;
+        return;
+    }
+    writer_putc(&filter->writers[0], c);
+}
 
 Filter* filter_init(const char* filename) {
-    Filter* filter = (Filter*)malloc(sizeof(Filter));
+    return filter_init_split(filename, NULL, NULL);
+}
+
+static char* writer_buffer(Filter* filter) {
+    if (USE_IO_URING) return uring_io_get_buffer();
+    if (filter->cache && filter->cache->buf) {
+        char* buf = filter->cache->buf;
+        filter->cache->buf = NULL;
+        return buf;
+    }
+    return malloc(FILTER_BUFFER_SIZE);
+}
+
+static void writer_buffer_release(Filter* filter, char* buf) {
+    if (!buf) {
+        return;
+    } else if (USE_IO_URING) {
+        uring_io_release_buffer(buf);
+    } else if (filter->cache && !filter->cache->buf) {
+        filter->cache->buf = buf;
+    } else {
+        free(buf);
+    }
+}
+
+// Hand the Filter and its row buffer back to the cache (or free them)
+static void filter_release(Filter* filter) {
+    FilterCache* cache = filter->cache;
+    if (cache && !cache->row_buf) {
+        cache->row_buf = filter->row_buf;
+        cache->row_capacity = filter->row_capacity;
+    } else {
+        free(filter->row_buf);
+    }
+    if (cache && !cache->filter) {
+        cache->filter = filter;
+    } else {
+        free(filter);
+    }
+}
+
+void filter_cache_free(FilterCache* cache) {
+    free(cache->filter);
+    free(cache->buf);
+    free(cache->row_buf);
+    memset(cache, 0, sizeof(*cache));
+}
+
+// Like filter_init; with split->shard_rows or split->partitions the sheet
+// goes to several files instead, each starting with the header row. cache
+// (may be NULL) supplies allocations left by an earlier Filter.
+Filter* filter_init_split(const char* filename, const FilterSplit* split, FilterCache* cache) {
+    Filter* filter = cache && cache->filter ? cache->filter : (Filter*)malloc(sizeof(Filter));
     if (!filter) {
         return NULL;
     }
-    
+    if (cache) cache->filter = NULL;
+    filter->cache = cache;
+
     filter->col_count = 0;
     filter->row_count = 0;
     filter->valid_col_count = 0;
-    
+
     // 명시적으로 모든 포인터를 NULL로 초기화
     for (int i = 0; i < MAX_COLUMNS; i++) {
         filter->headers[i].name = NULL;
         filter->headers[i].is_valid = 0;
     }
-    
-    filter->fp = fopen(filename, "w");
-    if (!filter->fp) {
-        free(filter);
+
+    filter->split = split && (split->shard_rows > 0 || split->partitions > 1);
+    filter->staged = filter->split;
+    filter->split_opts = filter->split ? *split : (FilterSplit){ 0, 1, NULL };
+    if (filter->split_opts.partitions > FILTER_MAX_PARTITIONS) {
+        filter->split_opts.partitions = FILTER_MAX_PARTITIONS;
+    }
+    filter->writer_count = filter->split_opts.partitions > 1 ? filter->split_opts.partitions : 1;
+    filter->writers = calloc(filter->writer_count, sizeof(FilterWriter));
+    filter->base_filename = strdup(filename);
+    filter->header = NULL;
+    filter->header_len = 0;
+    filter->row_buf = NULL;
+    filter->row_len = 0;
+    filter->row_capacity = 0;
+    if (cache && cache->row_buf) {
+        filter->row_buf = cache->row_buf;
+        filter->row_capacity = cache->row_capacity;
+        cache->row_buf = NULL;
+    }
+    filter->key_col = -1;
+    filter->key_start = 0;
+    filter->key_len = 0;
+    filter->file_count = 0;
+    filter->output_columns = 0;
+    filter->delta = NULL;
+    filter->row_hashes = NULL;
+    filter->row_hash_count = 0;
+    filter->row_hash_capacity = 0;
+    filter->delta_added = 0;
+    filter->delta_removed = 0;
+    filter->sort = NULL;
+    filter->sort_by = NULL;
+    filter->sort_key_count = 0;
+    filter->string_ranks = NULL;
+    filter->string_rank_count = 0;
+    filter->sort_runs = 0;
+    filter->columnar = NULL;
+    filter->stats = NULL;
+    filter->stats_filename = NULL;
+    filter->truncated = false;
+    filter->log = stdout;
+    if (!filter->writers || !filter->base_filename) {
+        free(filter->writers);
+        free(filter->base_filename);
+        filter_release(filter);
         return NULL;
     }
-    
+
+    int opened = 0;
+    for (; opened < filter->writer_count; opened++) {
+        FilterWriter* writer = &filter->writers[opened];
+        writer->partition = opened;
+        if (filter->split) {
+            if (!writer_open(filter, writer)) break;
+        } else {
+            writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (writer->fd < 0) break;
+            filter->file_count++;
+        }
+        writer->buf = writer_buffer(filter);
+        if (!writer->buf) {
+            close(writer->fd);
+            break;
+        }
+    }
+    if (opened < filter->writer_count) {
+        for (int i = 0; i < opened; i++) {
+            close(filter->writers[i].fd);
+            writer_buffer_release(filter, filter->writers[i].buf);
+        }
+        free(filter->writers);
+        free(filter->base_filename);
+        filter_release(filter);
+        return NULL;
+    }
+
     return filter;
 }
 
+// Total bytes written or still buffered across all output files
+long long filter_bytes(const Filter* filter) {
+    long long bytes = 0;
+    for (int i = 0; i < filter->writer_count; i++) {
+        const FilterWriter* writer = &filter->writers[i];
+        bytes += writer->bytes + (long long)writer->offset + (long long)writer->buf_len;
+    }
+    return bytes;
+}
+
+// Collect per-column statistics and write them to stats_filename on close
+int filter_enable_stats(Filter* filter, const char* stats_filename) {
+    filter->stats = calloc(MAX_COLUMNS, sizeof(ColumnStats));
+    filter->stats_filename = strdup(stats_filename);
+    if (!filter->stats || !filter->stats_filename) {
+        free(filter->stats);
+        free(filter->stats_filename);
+        filter->stats = NULL;
+        filter->stats_filename = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Write only rows whose hash is not among previous (call before the first
+// push); filter_finish_delta then adds the rows that disappeared
+int filter_enable_delta(Filter* filter, const uint64_t* previous, size_t count) {
+    filter->delta = malloc(sizeof(RowHashTable));
+    if (!filter->delta || !row_hash_table_init(filter->delta, previous, count)) {
+        free(filter->delta);
+        filter->delta = NULL;
+        return 0;
+    }
+    filter->staged = true;
+    return 1;
+}
+
+static void filter_clear_sort_keys(Filter* filter) {
+    for (int i = 0; i < filter->sort_key_count; i++) {
+        filter->sort_keys[i] = (ExtSortKey){ EXTSORT_NO_RANK, 0, 0 };
+    }
+}
+
+// Write data rows ordered by the sort_by columns (call before the first
+// push). string_ranks[i] is the collation rank of shared string i; cells
+// pushed with filter_push_string compare by it instead of by their text.
+int filter_enable_sort(Filter* filter, const char* sort_by, size_t memory_budget, int threads,
+                       const uint32_t* string_ranks, int string_rank_count) {
+    filter->sort_key_count = 1;
+    for (const char* c = sort_by; *c; c++) {
+        if (*c == ',') filter->sort_key_count++;
+    }
+    if (filter->sort_key_count > EXTSORT_MAX_KEYS) filter->sort_key_count = EXTSORT_MAX_KEYS;
+
+    filter->sort_by = strdup(sort_by);
+    filter->sort = extsort_create(filter->sort_key_count, memory_budget, threads, filter->base_filename);
+    if (!filter->sort_by || !filter->sort) {
+        free(filter->sort_by);
+        extsort_free(filter->sort);
+        filter->sort_by = NULL;
+        filter->sort = NULL;
+        filter->sort_key_count = 0;
+        return 0;
+    }
+    for (int i = 0; i < filter->sort_key_count; i++) {
+        filter->sort_cols[i] = -1;
+    }
+    filter_clear_sort_keys(filter);
+    filter->string_ranks = string_ranks;
+    filter->string_rank_count = string_rank_count;
+    filter->staged = true;
+    return 1;
+}
+
+static void filter_write_columnar(void* user, const void* data, size_t len) {
+    Filter* filter = user;
+    writer_write(&filter->writers[0], data, len);
+}
+
+// Write the sheet as a .xcol file (see colfile.h) instead of TSV text (call
+// before the first push). string_count: shared strings of the workbook.
+int filter_enable_columnar(Filter* filter, int string_count) {
+    filter->columnar = col_writer_create(filter_write_columnar, filter, string_count);
+    return filter->columnar != NULL;
+}
+
 // Check if sheet name contains only valid characters (A-Z, a-z, 0-9, -, _, *)
 int is_valid_name(const char* name) {
     for (int i = 0; name[i] != '\0'; i++) {
@@ -57,15 +397,96 @@ int is_valid_name(const char* name) {
     return name[0] != '\0';  // All characters are valid
 }
 
-void filter_close(Filter* filter) {
-    fclose(filter->fp);
+void remove_wildcards(const char* input, char* output, int max_len);
+
+static void filter_write_stats(Filter* filter) {
+    FILE* fp = fopen(filter->stats_filename, "w");
+    if (!fp) {
+        if (filter->log) fprintf(filter->log, "Warning: Could not create stats file: %s\n", filter->stats_filename);
+        return;
+    }
+
+    long long rows = filter->row_count > 0 ? filter->row_count - 1 : 0;  // minus header
+    fprintf(fp, "{\n  \"rows\": %lld,\n", rows);
+    if (filter->truncated) fprintf(fp, "  \"truncated\": true,\n");
+    fprintf(fp, "  \"columns\": [\n");
+    bool first = true;
+    for (int i = 0; i < MAX_COLUMNS; i++) {
+        if (!filter->headers[i].is_valid) continue;
+
+        char cleaned_name[MAX_COLUMNS * 10];
+        remove_wildcards(filter->headers[i].name, cleaned_name, sizeof(cleaned_name));
+        if (!first) fprintf(fp, ",\n");
+        colstats_write_json(fp, cleaned_name, &filter->stats[i], rows);
+        first = false;
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+}
+
+static void filter_columnar_header(Filter* filter);
+
+// Release everything; the output has been written (or is abandoned)
+static void filter_free(Filter* filter) {
+    extsort_free(filter->sort);
+    col_writer_free(filter->columnar);
+    if (filter->stats) {
+        for (int i = 0; i < MAX_COLUMNS; i++) {
+            if (filter->stats[i].hll) colstats_free(&filter->stats[i]);
+        }
+        free(filter->stats);
+        free(filter->stats_filename);
+    }
+
+    for (int i = 0; i < filter->writer_count; i++) {
+        writer_buffer_release(filter, filter->writers[i].buf);
+        if (filter->writers[i].fd >= 0) close(filter->writers[i].fd);
+    }
+    free(filter->writers);
+    free(filter->base_filename);
+    free(filter->header);
+    if (filter->delta) {
+        row_hash_table_free(filter->delta);
+        free(filter->delta);
+    }
+    free(filter->row_hashes);
+    free(filter->sort_by);
     // 헤더 이름들 해제
     for (int i = 0; i < MAX_COLUMNS; i++) {
         if (filter->headers[i].name) {
             free((char*)filter->headers[i].name);
         }
     }
-    free(filter);
+    filter_release(filter);
+}
+
+void filter_close(Filter* filter) {
+    filter_finish_sort(filter);
+    if (filter->columnar) {
+        if (filter->row_count == 0) filter_columnar_header(filter);
+        col_writer_finish(filter->columnar);
+    }
+    if (filter->stats) {
+        filter_write_stats(filter);
+    }
+
+    for (int i = 0; i < filter->writer_count; i++) {
+        writer_flush(&filter->writers[i]);
+    }
+    if (USE_IO_URING) {
+        // Wait for in-flight writes before closing the descriptors
+        uring_io_drain();
+    }
+    filter_free(filter);
+}
+
+// Close a Filter whose conversion ended with fatal_error, without writing
+// anything more. The files keep what was written so far.
+void filter_abort(Filter* filter) {
+    if (USE_IO_URING) {
+        uring_io_discard();
+    }
+    filter_free(filter);
 }
 
 // Remove * characters from string
@@ -80,36 +501,66 @@ void remove_wildcards(const char* input, char* output, int max_len) {
 }
 
 void filter_push(Filter* filter, const char* data) {
+    filter_push_string(filter, data, -1);
+}
+
+// string_index: the shared string data was taken from, -1 for other cells
+void filter_push_string(Filter* filter, const char* data, int string_index) {
     if (!filter || !data) {
         return;
     }
 
     if (filter->col_count >= MAX_COLUMNS) {
-        printf("Error: Too many columns\n");
-        exit(1);
+        fatal_error("Too many columns");
     }
 
     if (filter->row_count == 0) {
         filter->headers[filter->col_count].name = strdup(data);
         if (!filter->headers[filter->col_count].name) {
-            printf("Error: Memory allocation failed\n");
-            exit(1);
+            fatal_error("Memory allocation failed");
         }
         filter->headers[filter->col_count].is_valid = is_valid_name(data);
+        if (filter->stats && filter->headers[filter->col_count].is_valid) {
+            colstats_init(&filter->stats[filter->col_count]);
+        }
     }
 
-    if (filter->headers[filter->col_count].is_valid) {
+    if (filter->headers[filter->col_count].is_valid && filter->columnar) {
+        // Header names are taken from headers[] when the header row ends
+        if (filter->row_count > 0) {
+            size_t len = strlen(data);
+            col_writer_cell(filter->columnar, filter->valid_col_count, data, len, string_index);
+            if (filter->stats) {
+                colstats_add(&filter->stats[filter->col_count], data, len);
+            }
+        }
+        filter->valid_col_count++;
+    } else if (filter->headers[filter->col_count].is_valid) {
         if (filter->valid_col_count > 0) {
-            fputc('\t', filter->fp);
+            filter_putc(filter, '\t');
         }
 
         // Remove * characters only from header row (first row)
         if (filter->row_count == 0) {
             char cleaned_data[MAX_COLUMNS * 10];  // Sufficient buffer size
             remove_wildcards(data, cleaned_data, sizeof(cleaned_data));
-            fputs(cleaned_data, filter->fp);
+            filter_write(filter, cleaned_data, strlen(cleaned_data));
         } else {
-            fputs(data, filter->fp);
+            size_t len = strlen(data);
+            if (filter->col_count == filter->key_col) {
+                filter->key_start = filter->row_len;
+                filter->key_len = len;
+            }
+            for (int i = 0; i < filter->sort_key_count; i++) {
+                if (filter->sort_cols[i] != filter->col_count) continue;
+                uint32_t rank = string_index >= 0 && string_index < filter->string_rank_count
+                                    ? filter->string_ranks[string_index] : EXTSORT_NO_RANK;
+                filter->sort_keys[i] = (ExtSortKey){ rank, (uint32_t)filter->row_len, (uint32_t)len };
+            }
+            filter_write(filter, data, len);
+            if (filter->stats) {
+                colstats_add(&filter->stats[filter->col_count], data, len);
+            }
         }
 
         filter->valid_col_count++;
@@ -118,8 +569,206 @@ void filter_push(Filter* filter, const char* data) {
     filter->col_count++;
 }
 
+#define DELTA_HEADER "op\trow_hash\t"
+
+// Output column whose header (without wildcards) is name[0..len), or -1
+static int filter_find_column(Filter* filter, const char* name, size_t len) {
+    for (int i = 0; i < MAX_COLUMNS && filter->headers[i].name; i++) {
+        char cleaned_name[MAX_COLUMNS * 10];
+        remove_wildcards(filter->headers[i].name, cleaned_name, sizeof(cleaned_name));
+        if (filter->headers[i].is_valid && strlen(cleaned_name) == len && memcmp(cleaned_name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Header row of a staged sheet: keep it for every file and find the key column
+static void filter_staged_header(Filter* filter) {
+    size_t prefix_len = filter->delta ? strlen(DELTA_HEADER) : 0;
+    filter->header = malloc(prefix_len + filter->row_len + 1);
+    if (!filter->header) {
+        fatal_error("Memory allocation failed");
+    }
+    memcpy(filter->header, DELTA_HEADER, prefix_len);
+    memcpy(filter->header + prefix_len, filter->row_buf, filter->row_len);
+    filter->header[prefix_len + filter->row_len] = '\n';
+    filter->header_len = prefix_len + filter->row_len + 1;
+    filter->output_columns = filter->valid_col_count;
+
+    const char* key = filter->split_opts.partition_by;
+    if (filter->writer_count > 1 && key) {
+        filter->key_col = filter_find_column(filter, key, strlen(key));
+        if (filter->key_col < 0 && filter->log) {
+            fprintf(filter->log, "Warning: Partition column not found: %s - partitioning by whole row\n", key);
+        }
+    }
+
+    const char* name = filter->sort_by;
+    for (int i = 0; i < filter->sort_key_count; i++) {
+        size_t name_len = strcspn(name, ",");
+        filter->sort_cols[i] = filter_find_column(filter, name, name_len);
+        if (filter->sort_cols[i] < 0 && filter->log) {
+            fprintf(filter->log, "Warning: Sort column not found: %.*s - sorting it as empty\n", (int)name_len, name);
+        }
+        name += name_len + (name[name_len] == ',');
+    }
+
+    for (int i = 0; i < filter->writer_count; i++) {
+        writer_write(&filter->writers[i], filter->header, filter->header_len);
+    }
+}
+
+// Write a data row (after an optional prefix) to a partition's writer,
+// rolling it over to a new shard file every shard_rows rows
+static void filter_write_row(Filter* filter, FilterWriter* writer, const char* prefix, size_t prefix_len,
+                             const char* row, size_t row_len) {
+    if (filter->split_opts.shard_rows > 0 && writer->rows >= filter->split_opts.shard_rows) {
+        writer_close(writer);
+        writer->shard++;
+        if (!writer_open(filter, writer)) {
+            fatal_error("Could not create shard %d of %s: %s", writer->shard, filter->base_filename,
+                        strerror(errno));
+        }
+        writer_write(writer, filter->header, filter->header_len);
+    }
+
+    writer_write(writer, prefix, prefix_len);
+    writer_write(writer, row, row_len);
+    writer_putc(writer, '\n');
+    writer->rows++;
+}
+
+// Route the finished data row in row_buf to its partition, or hand it to
+// the sort together with the partition
+static void filter_route_row(Filter* filter, const char* prefix, size_t prefix_len) {
+    int partition = 0;
+    if (filter->writer_count > 1) {
+        uint64_t hash = filter->key_col >= 0
+            ? hash64(filter->row_buf + filter->key_start, filter->key_len)
+            : hash64(filter->row_buf, filter->row_len);
+        partition = (int)(hash % (uint64_t)filter->writer_count);
+    }
+
+    if (filter->sort) {
+        extsort_add(filter->sort, prefix, prefix_len, filter->row_buf, filter->row_len, filter->sort_keys, partition);
+        return;
+    }
+    filter_write_row(filter, &filter->writers[partition], prefix, prefix_len, filter->row_buf, filter->row_len);
+}
+
+static void filter_write_sorted_row(void* user, const char* row, size_t len, int partition) {
+    Filter* filter = user;
+    filter_write_row(filter, &filter->writers[partition], "", 0, row, len);
+}
+
+// Write the sorted data rows; after filter_finish_delta in delta mode.
+// filter_close calls it if the caller has not.
+void filter_finish_sort(Filter* filter) {
+    if (!filter->sort) return;
+    filter->sort_runs = extsort_spilled_runs(filter->sort);
+    extsort_finish(filter->sort, filter_write_sorted_row, filter);
+    extsort_free(filter->sort);
+    filter->sort = NULL;
+}
+
+// Delta mode: remember the row's hash and write it only if it is new
+static void filter_delta_row(Filter* filter) {
+    uint64_t hash = hash64(filter->row_buf, filter->row_len);
+    if (filter->row_hash_count >= filter->row_hash_capacity) {
+        size_t capacity = filter->row_hash_capacity ? filter->row_hash_capacity * 2 : 4096;
+        uint64_t* grown = realloc(filter->row_hashes, sizeof(uint64_t) * capacity);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        filter->row_hashes = grown;
+        filter->row_hash_capacity = capacity;
+    }
+    filter->row_hashes[filter->row_hash_count++] = hash;
+
+    if (row_hash_table_take(filter->delta, hash)) return;
+
+    char prefix[32];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "+\t%016llx\t", (unsigned long long)hash);
+    filter_route_row(filter, prefix, (size_t)prefix_len);
+    filter->delta_added++;
+}
+
+// Write the removed rows (op "-", row_hash, empty cells) and return this
+// run's row hashes sorted, for the next --diff-against; the caller frees them.
+// A truncated sheet has no removed rows: the rest of it was never read.
+uint64_t* filter_finish_delta(Filter* filter, size_t* count) {
+    if (filter->row_count > 0 && !filter->truncated) {
+        // Removed rows have no cells; keep the column count of the header
+        filter->row_len = 0;
+        filter->key_len = 0;
+        for (int i = 1; i < filter->output_columns; i++) {
+            filter_putc(filter, '\t');
+        }
+
+        RowHashTable* table = filter->delta;
+        for (size_t slot = 0; slot <= table->mask; slot++) {
+            for (uint32_t n = table->counts[slot]; n > 1; n--) {
+                char prefix[32];
+                int prefix_len = snprintf(prefix, sizeof(prefix), "-\t%016llx\t",
+                                          (unsigned long long)table->keys[slot]);
+                filter_route_row(filter, prefix, (size_t)prefix_len);
+                filter->delta_removed++;
+            }
+        }
+        filter->row_len = 0;
+    }
+
+    uint64_t* hashes = filter->row_hashes;
+    *count = filter->row_hash_count;
+    row_hash_sort(hashes, *count);
+    filter->row_hashes = NULL;
+    filter->row_hash_count = 0;
+    filter->row_hash_capacity = 0;
+    return hashes;
+}
+
+// Columnar sheet: the header row's cleaned names become the column names
+static void filter_columnar_header(Filter* filter) {
+    char* names[MAX_COLUMNS];
+    int count = 0;
+    for (int i = 0; i < MAX_COLUMNS && filter->headers[i].name; i++) {
+        if (!filter->headers[i].is_valid) continue;
+        char cleaned_name[MAX_COLUMNS * 10];
+        remove_wildcards(filter->headers[i].name, cleaned_name, sizeof(cleaned_name));
+        names[count] = strdup(cleaned_name);
+        if (!names[count]) {
+            fatal_error("Memory allocation failed");
+        }
+        count++;
+    }
+    col_writer_begin(filter->columnar, count, names);
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+}
+
 void filter_finish_line(Filter* filter) {
-    fputc('\n', filter->fp);
+    if (filter->columnar) {
+        if (filter->row_count == 0) {
+            filter_columnar_header(filter);
+        } else {
+            col_writer_end_row(filter->columnar, filter->valid_col_count);
+        }
+    } else if (filter->staged) {
+        if (filter->row_count == 0) {
+            filter_staged_header(filter);
+        } else if (filter->delta) {
+            filter_delta_row(filter);
+        } else {
+            filter_route_row(filter, "", 0);
+        }
+        filter->row_len = 0;
+        filter->key_len = 0;
+        filter_clear_sort_keys(filter);
+    } else {
+        filter_putc(filter, '\n');
+    }
     filter->row_count++;
     filter->col_count = 0;
     filter->valid_col_count = 0;
@@ -7,26 +7,134 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+
+#include "colstats.h"
+#include "rowhash.h"
+#include "extsort.h"
+#include "colfile.h"
 
 #define MAX_COLUMNS 1000
+#define FILTER_BUFFER_SIZE (256 * 1024)
+
+// Row routing for one sheet (--shard-rows, --partition-by/--partitions)
+typedef struct {
+    int shard_rows;             // data rows per file, 0 = no sharding
+    int partitions;             // files to hash rows into, <= 1 = no partitioning
+    const char* partition_by;   // key column (header name) for partitioning
+} FilterSplit;
+
+#define FILTER_MAX_PARTITIONS 256
 
+// One output file. Output is buffered here and flushed with write() or,
+// when USE_IO_URING is set, submitted as an async write (see uring_io.h)
 typedef struct {
+    int fd;
+    char* buf;
+    size_t buf_len;
+    off_t offset;               // file offset of buf[0]
+    long long bytes;            // written to earlier shards of this writer
+    int rows;                   // data rows in the current shard
+    int shard;
+    int partition;
+} FilterWriter;
+
+// Allocations handed from one sheet's Filter to the next (one per
+// conversion context, so per --serve worker): the Filter with its header
+// table, a FILTER_BUFFER_SIZE write buffer and the row staging buffer.
+// io_uring buffers are recycled by uring_io instead.
+typedef struct FilterCache {
+    struct Filter* filter;
+    char* buf;
+    char* row_buf;
+    size_t row_capacity;
+} FilterCache;
+
+typedef struct Filter {
     
     struct {
         char* name;
         bool is_valid;
     } headers[MAX_COLUMNS];
 
-    FILE *fp;
+    // One writer, or one per partition when the sheet is split. Split and
+    // delta sheets stage each row in row_buf and route it on finish_line.
+    FilterWriter* writers;
+    int writer_count;
+    bool split;
+    bool staged;
+    FilterSplit split_opts;
+    char* base_filename;        // <Sheet>.tsv; split files insert .pNNNNN/.NNNNN
+    char* header;               // header line repeated at the top of every file
+    size_t header_len;
+    char* row_buf;
+    size_t row_len;
+    size_t row_capacity;
+    int key_col;                // partition key column, -1 = hash the whole row
+    size_t key_start;           // key cell within row_buf
+    size_t key_len;
+    int file_count;
+    int output_columns;
+
+    // --diff-against: previous run's row hashes, NULL when disabled. Only
+    // rows missing there are written, prefixed with op and row_hash.
+    RowHashTable* delta;
+    uint64_t* row_hashes;       // every data row of this run
+    size_t row_hash_count;
+    size_t row_hash_capacity;
+    long long delta_added;
+    long long delta_removed;
+
+    // --sort-by: staged rows go through an external sort and are written by
+    // filter_finish_sort, NULL when disabled
+    ExtSort* sort;
+    char* sort_by;              // comma-separated header names
+    int sort_key_count;
+    int sort_cols[EXTSORT_MAX_KEYS];        // column per key, -1 = not in header
+    ExtSortKey sort_keys[EXTSORT_MAX_KEYS]; // keys of the current row
+    const uint32_t* string_ranks;           // collation rank per shared string
+    int string_rank_count;
+    int sort_runs;              // runs spilled to disk
+
+    // --format=col: data cells go to a columnar writer instead of the TSV
+    // text, which holds only the file it produces; NULL for TSV output
+    ColWriter* columnar;
+
+    // Per-column statistics (--profile-columns), NULL when disabled
+    ColumnStats* stats;
+    char* stats_filename;
+
+    // Set by the parser when --deadline / --max-cells stopped the sheet
+    // early: the output holds the rows before that point. Recorded in the
+    // stats, and delta output then leaves out removed rows (unknown).
+    bool truncated;
+
     int col_count;
     int valid_col_count;
     int row_count;
+
+    FILE* log;                  // conversion log for warnings (stdout), NULL = quiet
+    FilterCache* cache;         // gets the allocations back on close, may be NULL
 } Filter;
 
 Filter* filter_init(const char* filename);
+Filter* filter_init_split(const char* filename, const FilterSplit* split, FilterCache* cache);
+void filter_cache_free(FilterCache* cache);
+long long filter_bytes(const Filter* filter);
 void filter_close(Filter* filter);
+void filter_abort(Filter* filter);
+int filter_enable_stats(Filter* filter, const char* stats_filename);
+int filter_enable_delta(Filter* filter, const uint64_t* previous, size_t count);
+uint64_t* filter_finish_delta(Filter* filter, size_t* count);
+int filter_enable_sort(Filter* filter, const char* sort_by, size_t memory_budget, int threads,
+                       const uint32_t* string_ranks, int string_rank_count);
+void filter_finish_sort(Filter* filter);
+int filter_enable_columnar(Filter* filter, int string_count);
 void filter_push(Filter* filter, const char* data);
+void filter_push_string(Filter* filter, const char* data, int string_index);
 void filter_finish_line(Filter* filter);
 int is_valid_name(const char* name);
 
-extern bool ALLOW_WILD_CARD;
\ No newline at end of file
+// Per-thread so --serve workers can run jobs with different options
+extern _Thread_local bool ALLOW_WILD_CARD;
+extern _Thread_local bool USE_IO_URING;
\ No newline at end of file
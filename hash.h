@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// *** HASH
+// Fast non-cryptographic 64-bit hash for cell values (8 bytes per step,
+// murmur3 finalizer). Used for distinct estimates and row fingerprints.
+
+static inline uint64_t hash64_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t hash64_seed(const void* data, size_t len, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed ^ (len * 0x9e3779b97f4a7c15ULL);
+
+    while (len >= 8) {
+        uint64_t k;
+        memcpy(&k, p, 8);
+        k *= 0x87c37b91114253d5ULL;
+        k = (k << 31) | (k >> 33);
+        h = (h ^ k) * 0x4cf5ad432745937fULL;
+        h = (h << 27) | (h >> 37);
+        p += 8;
+        len -= 8;
+    }
+
+    uint64_t k = 0;
+    for (size_t i = 0; i < len; i++) {
+        k |= (uint64_t)p[i] << (i * 8);
+    }
+    h ^= k * 0x87c37b91114253d5ULL;
+
+    return hash64_mix(h);
+}
+
+static inline uint64_t hash64(const void* data, size_t len) {
+    return hash64_seed(data, len, 0);
+}
+// *** HASH END
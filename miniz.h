@@ -3,6 +3,14 @@
 // *** MINIZ
 #include <zlib.h>
 
+#include "budget.h"
+
+// Inflating stops between chunks of this many output bytes (or at each
+// input chunk when streaming) once budget_poll() fails. The extract call
+// then returns 0; the bytes inflated so far stay in the output buffer
+// (extracted_size, or the mz_zip_buffer's size when streaming).
+#define MZ_INFLATE_SLICE (1 << 20)
+
 // ZIP file structures
 #pragma pack(push, 1)
 typedef struct {
@@ -56,6 +64,7 @@ typedef struct {
     uint32_t total_entries;
     uint32_t central_dir_offset;
     mz_zip_central_dir_entry* entries;
+    size_t extracted_size;      // bytes written by the last extract, also when cut short
 } mz_zip_archive;
 
 // Function declarations
@@ -65,8 +74,62 @@ int mz_zip_reader_locate_file(mz_zip_archive* zip, const char* name, int* file_i
 int mz_zip_reader_extract_to_mem(mz_zip_archive* zip, int file_index, void* buf, size_t buf_size);
 size_t mz_zip_reader_get_file_size(mz_zip_archive* zip, int file_index);
 
+// Inflate access points (zran-style random access into deflated entries)
+typedef void (*mz_zip_point_callback)(void* user, size_t out_pos, size_t in_pos, int bits);
+int mz_zip_reader_extract_to_mem_points(mz_zip_archive* zip, int file_index, void* buf, size_t buf_size,
+                                        mz_zip_point_callback on_point, void* user);
+
+typedef struct {
+    FILE* file;
+    int method;
+    size_t remaining;         // compressed (or stored) bytes left to read
+    unsigned char* in_buf;
+    z_stream strm;
+    int done;
+} mz_zip_inflate_cursor;
+
+int mz_zip_reader_inflate_open(mz_zip_archive* zip, int file_index, size_t in_pos, int bits,
+                               const unsigned char* window, size_t window_len, mz_zip_inflate_cursor* cursor);
+long mz_zip_reader_inflate_read(mz_zip_inflate_cursor* cursor, void* buf, size_t len);
+void mz_zip_reader_inflate_close(mz_zip_inflate_cursor* cursor);
+
+// Sequential reader for archives arriving on a pipe (no central directory):
+// walks local file headers in order. With general purpose flag bit 3 the
+// sizes follow the data in a data descriptor, so deflated entries are
+// inflated to find their end.
+#define MZ_STREAM_MAX_NAME 1024
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} mz_zip_buffer;
+
+typedef struct {
+    FILE* file;
+    unsigned char* buf;       // read-ahead; keeps input inflate did not consume
+    size_t buf_pos;
+    size_t buf_len;
+    int pending;              // current entry's data not read yet
+    char name[MZ_STREAM_MAX_NAME];
+    uint16_t flags;
+    uint16_t method;
+    int zip64;
+    uint64_t comp_size;       // 0 until the data descriptor when flags bit 3 is set
+    uint64_t uncomp_size;
+} mz_zip_stream;
+
+int mz_zip_stream_init(mz_zip_stream* stream, FILE* file);
+int mz_zip_stream_next(mz_zip_stream* stream);
+int mz_zip_stream_extract(mz_zip_stream* stream, mz_zip_buffer* out);
+int mz_zip_stream_read_raw(mz_zip_stream* stream, mz_zip_buffer* raw);
+void mz_zip_stream_end(mz_zip_stream* stream);
+int mz_zip_inflate_mem(const void* comp, size_t comp_size, int method, mz_zip_buffer* out);
+
 // Implementation
 int mz_zip_reader_init_file(mz_zip_archive* zip, const char* filename) {
+    // Left zeroed on failure, so mz_zip_reader_end is always safe
+    memset(zip, 0, sizeof(*zip));
     zip->file = fopen(filename, "rb");
     if (!zip->file) return 0;
     
@@ -76,7 +139,7 @@ int mz_zip_reader_init_file(mz_zip_archive* zip, const char* filename) {
     fread(&end_dir, sizeof(end_dir), 1, zip->file);
     
     if (end_dir.signature != 0x06054b50) {
-        fclose(zip->file);
+        mz_zip_reader_end(zip);
         return 0;
     }
     
@@ -147,6 +210,7 @@ size_t mz_zip_reader_get_file_size(mz_zip_archive* zip, int file_index) {
 
 int mz_zip_reader_extract_to_mem(mz_zip_archive* zip, int file_index, void* buf, size_t buf_size) {
     mz_zip_central_dir_entry* entry = &zip->entries[file_index];
+    zip->extracted_size = 0;
     
     fseek(zip->file, entry->local_header_offset, SEEK_SET);
     mz_zip_local_file_header local_header;
@@ -158,6 +222,7 @@ int mz_zip_reader_extract_to_mem(mz_zip_archive* zip, int file_index, void* buf,
     if (entry->method == 0) {
         // Stored (no compression)
         fread(buf, entry->uncomp_size, 1, zip->file);
+        zip->extracted_size = entry->uncomp_size;
         return 1;
     } else if (entry->method == 8) {
         // Deflate compression - use zlib
@@ -176,7 +241,13 @@ int mz_zip_reader_extract_to_mem(mz_zip_archive* zip, int file_index, void* buf,
             return 0;
         }
         
-        int result = inflate(&strm, Z_FINISH);
+        int result = Z_OK;
+        while (result == Z_OK && !budget_poll()) {
+            size_t left = buf_size - strm.total_out;
+            strm.avail_out = left < MZ_INFLATE_SLICE ? left : MZ_INFLATE_SLICE;
+            result = inflate(&strm, strm.avail_out == left ? Z_FINISH : Z_NO_FLUSH);
+        }
+        zip->extracted_size = strm.total_out;
         inflateEnd(&strm);
         free(comp_data);
         
@@ -186,4 +257,404 @@ int mz_zip_reader_extract_to_mem(mz_zip_archive* zip, int file_index, void* buf,
         return 0;
     }
 }
+
+#define MZ_INFLATE_CHUNK 65536
+
+// Offset of an entry's data (just past its local header)
+static long mz_zip_entry_data_offset(mz_zip_archive* zip, int file_index) {
+    mz_zip_central_dir_entry* entry = &zip->entries[file_index];
+    mz_zip_local_file_header local_header;
+    fseek(zip->file, entry->local_header_offset, SEEK_SET);
+    if (fread(&local_header, sizeof(local_header), 1, zip->file) != 1) return -1;
+    return (long)entry->local_header_offset + (long)sizeof(local_header) +
+           local_header.name_len + local_header.extra_len;
+}
+
+// Same as mz_zip_reader_extract_to_mem, but inflates one deflate block at a
+// time and reports every block boundary (uncompressed offset, compressed
+// offset, unused bits) where inflation can later be resumed.
+int mz_zip_reader_extract_to_mem_points(mz_zip_archive* zip, int file_index, void* buf, size_t buf_size,
+                                        mz_zip_point_callback on_point, void* user) {
+    mz_zip_central_dir_entry* entry = &zip->entries[file_index];
+    zip->extracted_size = 0;
+    if (entry->method == 0) {
+        // Stored entries can be resumed anywhere; one point at the start is enough
+        if (!mz_zip_reader_extract_to_mem(zip, file_index, buf, buf_size)) return 0;
+        on_point(user, 0, 0, 0);
+        return 1;
+    }
+    if (entry->method != 8) return 0;
+
+    long data_offset = mz_zip_entry_data_offset(zip, file_index);
+    if (data_offset < 0) return 0;
+    fseek(zip->file, data_offset, SEEK_SET);
+
+    char* comp_data = malloc(entry->comp_size);
+    if (!comp_data || fread(comp_data, 1, entry->comp_size, zip->file) != entry->comp_size) {
+        free(comp_data);
+        return 0;
+    }
+
+    z_stream strm = {0};
+    strm.next_in = (Bytef*)comp_data;
+    strm.avail_in = entry->comp_size;
+    strm.next_out = (Bytef*)buf;
+    strm.avail_out = buf_size;
+    if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+        free(comp_data);
+        return 0;
+    }
+
+    on_point(user, 0, 0, 0);
+    int result;
+    do {
+        result = inflate(&strm, Z_BLOCK);
+        // 128: just after an end-of-block code; 64: inside the last block
+        if (result == Z_OK && (strm.data_type & 128) && !(strm.data_type & 64)) {
+            on_point(user, strm.total_out, strm.total_in, strm.data_type & 7);
+            if (budget_poll()) break;
+        }
+    } while (result == Z_OK);
+
+    zip->extracted_size = strm.total_out;
+    inflateEnd(&strm);
+    free(comp_data);
+    return (result == Z_STREAM_END) ? 1 : 0;
+}
+
+// Start inflating an entry at an access point. window holds the (up to
+// 32 KB of) uncompressed data that precedes the point.
+int mz_zip_reader_inflate_open(mz_zip_archive* zip, int file_index, size_t in_pos, int bits,
+                               const unsigned char* window, size_t window_len, mz_zip_inflate_cursor* cursor) {
+    mz_zip_central_dir_entry* entry = &zip->entries[file_index];
+    memset(cursor, 0, sizeof(*cursor));
+    if (entry->method != 0 && entry->method != 8) return 0;
+
+    long data_offset = mz_zip_entry_data_offset(zip, file_index);
+    if (data_offset < 0) return 0;
+
+    cursor->file = zip->file;
+    cursor->method = entry->method;
+    if (entry->method == 0) {
+        fseek(zip->file, data_offset + (long)in_pos, SEEK_SET);
+        cursor->remaining = entry->uncomp_size - in_pos;
+        return 1;
+    }
+
+    // A point inside a byte needs that byte's remaining bits primed first
+    size_t start = in_pos - (bits ? 1 : 0);
+    fseek(zip->file, data_offset + (long)start, SEEK_SET);
+    cursor->remaining = entry->comp_size - start;
+    cursor->in_buf = malloc(MZ_INFLATE_CHUNK);
+    if (!cursor->in_buf || inflateInit2(&cursor->strm, -MAX_WBITS) != Z_OK) {
+        free(cursor->in_buf);
+        cursor->in_buf = NULL;
+        return 0;
+    }
+
+    if (bits) {
+        int ch = fgetc(zip->file);
+        if (ch == EOF) {
+            mz_zip_reader_inflate_close(cursor);
+            return 0;
+        }
+        cursor->remaining--;
+        inflatePrime(&cursor->strm, bits, ch >> (8 - bits));
+    }
+    if (window_len > 0) {
+        inflateSetDictionary(&cursor->strm, window, window_len);
+    }
+    return 1;
+}
+
+// Read up to len uncompressed bytes; returns bytes produced, 0 at end, -1 on error
+long mz_zip_reader_inflate_read(mz_zip_inflate_cursor* cursor, void* buf, size_t len) {
+    if (cursor->done) return 0;
+
+    if (cursor->method == 0) {
+        size_t n = len < cursor->remaining ? len : cursor->remaining;
+        n = fread(buf, 1, n, cursor->file);
+        cursor->remaining -= n;
+        if (n == 0) cursor->done = 1;
+        return (long)n;
+    }
+
+    cursor->strm.next_out = (Bytef*)buf;
+    cursor->strm.avail_out = len;
+    while (cursor->strm.avail_out > 0) {
+        if (cursor->strm.avail_in == 0 && cursor->remaining > 0) {
+            size_t n = cursor->remaining < MZ_INFLATE_CHUNK ? cursor->remaining : MZ_INFLATE_CHUNK;
+            n = fread(cursor->in_buf, 1, n, cursor->file);
+            if (n == 0) return -1;
+            cursor->remaining -= n;
+            cursor->strm.next_in = cursor->in_buf;
+            cursor->strm.avail_in = n;
+        }
+        int result = inflate(&cursor->strm, Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            cursor->done = 1;
+            break;
+        }
+        if (result != Z_OK && result != Z_BUF_ERROR) return -1;
+        if (result == Z_BUF_ERROR && cursor->strm.avail_in == 0 && cursor->remaining == 0) return -1;
+    }
+    return (long)(len - cursor->strm.avail_out);
+}
+
+void mz_zip_reader_inflate_close(mz_zip_inflate_cursor* cursor) {
+    if (cursor->in_buf) {
+        inflateEnd(&cursor->strm);
+        free(cursor->in_buf);
+    }
+    memset(cursor, 0, sizeof(*cursor));
+}
+// Make room for len more bytes plus a NUL terminator
+static int mz_zip_buffer_reserve(mz_zip_buffer* buf, size_t len) {
+    if (buf->size + len + 1 <= buf->capacity) return 1;
+    size_t capacity = buf->capacity ? buf->capacity : MZ_INFLATE_CHUNK;
+    while (capacity < buf->size + len + 1) capacity *= 2;
+    char* grown = realloc(buf->data, capacity);
+    if (!grown) return 0;
+    buf->data = grown;
+    buf->capacity = capacity;
+    return 1;
+}
+
+static int mz_zip_buffer_append(mz_zip_buffer* buf, const void* data, size_t len) {
+    if (!mz_zip_buffer_reserve(buf, len)) return 0;
+    memcpy(buf->data + buf->size, data, len);
+    buf->size += len;
+    return 1;
+}
+
+int mz_zip_stream_init(mz_zip_stream* stream, FILE* file) {
+    memset(stream, 0, sizeof(*stream));
+    stream->file = file;
+    stream->buf = malloc(MZ_INFLATE_CHUNK);
+    return stream->buf != NULL;
+}
+
+// Bytes available in the read-ahead buffer, refilling it when empty
+static size_t mz_zip_stream_fill(mz_zip_stream* stream) {
+    if (stream->buf_pos == stream->buf_len) {
+        stream->buf_len = fread(stream->buf, 1, MZ_INFLATE_CHUNK, stream->file);
+        stream->buf_pos = 0;
+    }
+    return stream->buf_len - stream->buf_pos;
+}
+
+// Copy len bytes of input to dst (or skip them when dst is NULL)
+static int mz_zip_stream_read(mz_zip_stream* stream, void* dst, size_t len) {
+    while (len > 0) {
+        size_t avail = mz_zip_stream_fill(stream);
+        if (avail == 0) return 0;
+        size_t n = len < avail ? len : avail;
+        if (dst) {
+            memcpy(dst, stream->buf + stream->buf_pos, n);
+            dst = (char*)dst + n;
+        }
+        stream->buf_pos += n;
+        len -= n;
+    }
+    return 1;
+}
+
+// Consume the current entry's data: uncompressed bytes go to out and the
+// compressed bytes to raw (either may be NULL). Entries with known sizes
+// are copied or skipped without inflating unless out is wanted.
+static int mz_zip_stream_data(mz_zip_stream* stream, mz_zip_buffer* out, mz_zip_buffer* raw) {
+    int descriptor = stream->flags & 8;
+    stream->pending = 0;
+    if (out) out->size = 0;
+    if (raw) raw->size = 0;
+
+    if (!descriptor && (stream->method == 0 || !out)) {
+        uint64_t left = stream->comp_size;
+        while (left > 0) {
+            size_t avail = mz_zip_stream_fill(stream);
+            if (avail == 0) return 0;
+            size_t n = left < avail ? (size_t)left : avail;
+            const unsigned char* data = stream->buf + stream->buf_pos;
+            if (out && !mz_zip_buffer_append(out, data, n)) return 0;
+            if (raw && !mz_zip_buffer_append(raw, data, n)) return 0;
+            stream->buf_pos += n;
+            left -= n;
+        }
+    } else if (stream->method == 8) {
+        unsigned char* scratch = out ? NULL : malloc(MZ_INFLATE_CHUNK);
+        if (!out && !scratch) return 0;
+        if (out && stream->uncomp_size > 0 && !mz_zip_buffer_reserve(out, stream->uncomp_size)) {
+            free(scratch);
+            return 0;
+        }
+
+        z_stream strm = {0};
+        if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+            free(scratch);
+            return 0;
+        }
+
+        uint64_t left = descriptor ? UINT64_MAX : stream->comp_size;
+        int result = Z_OK;
+        while (result != Z_STREAM_END && !budget_poll()) {
+            size_t avail = mz_zip_stream_fill(stream);
+            if (avail == 0 || left == 0) break;
+            if (avail > left) avail = (size_t)left;
+            strm.next_in = stream->buf + stream->buf_pos;
+            strm.avail_in = avail;
+            do {
+                if (out) {
+                    if (!mz_zip_buffer_reserve(out, MZ_INFLATE_CHUNK)) {
+                        result = Z_MEM_ERROR;
+                        break;
+                    }
+                    strm.next_out = (Bytef*)out->data + out->size;
+                } else {
+                    strm.next_out = scratch;
+                }
+                strm.avail_out = MZ_INFLATE_CHUNK;
+                result = inflate(&strm, Z_NO_FLUSH);
+                if (out) out->size += MZ_INFLATE_CHUNK - strm.avail_out;
+            } while (result == Z_OK && (strm.avail_in > 0 || strm.avail_out == 0));
+
+            size_t used = avail - strm.avail_in;
+            if (raw && !mz_zip_buffer_append(raw, stream->buf + stream->buf_pos, used)) break;
+            stream->buf_pos += used;
+            left -= used;
+            if (result == Z_BUF_ERROR) result = Z_OK;
+            if (result != Z_OK && result != Z_STREAM_END) break;
+        }
+        inflateEnd(&strm);
+        free(scratch);
+        if (result != Z_STREAM_END) return 0;
+        if (!descriptor && left > 0 && !mz_zip_stream_read(stream, NULL, left)) return 0;
+    } else {
+        return 0;  // stored data with a descriptor has no end marker; other methods unsupported
+    }
+
+    if (out) {
+        if (!mz_zip_buffer_reserve(out, 0)) return 0;
+        out->data[out->size] = '\0';
+    }
+
+    if (descriptor) {
+        // [signature] crc32, compressed size, uncompressed size (8-byte sizes for zip64)
+        uint32_t word;
+        if (!mz_zip_stream_read(stream, &word, 4)) return 0;
+        if (word == 0x08074b50 && !mz_zip_stream_read(stream, &word, 4)) return 0;
+        if (stream->zip64) {
+            uint64_t sizes[2];
+            if (!mz_zip_stream_read(stream, sizes, sizeof(sizes))) return 0;
+            stream->comp_size = sizes[0];
+            stream->uncomp_size = sizes[1];
+        } else {
+            uint32_t sizes[2];
+            if (!mz_zip_stream_read(stream, sizes, sizeof(sizes))) return 0;
+            stream->comp_size = sizes[0];
+            stream->uncomp_size = sizes[1];
+        }
+    }
+    return 1;
+}
+
+// Advance to the next local file header, skipping unread data of the
+// current entry. Returns 1 for an entry, 0 at the central directory and
+// -1 when the input is truncated or not a zip archive.
+int mz_zip_stream_next(mz_zip_stream* stream) {
+    if (stream->pending && !mz_zip_stream_data(stream, NULL, NULL)) return -1;
+
+    mz_zip_local_file_header header;
+    if (!mz_zip_stream_read(stream, &header.signature, 4)) return -1;
+    if (header.signature == 0x02014b50 || header.signature == 0x06054b50) return 0;
+    if (header.signature != 0x04034b50 ||
+        !mz_zip_stream_read(stream, (char*)&header + 4, sizeof(header) - 4)) {
+        return -1;
+    }
+
+    size_t name_len = header.name_len < MZ_STREAM_MAX_NAME ? header.name_len : MZ_STREAM_MAX_NAME - 1;
+    if (!mz_zip_stream_read(stream, stream->name, name_len) ||
+        !mz_zip_stream_read(stream, NULL, header.name_len - name_len)) {
+        return -1;
+    }
+    stream->name[name_len] = '\0';
+
+    stream->flags = header.flags;
+    stream->method = header.method;
+    stream->comp_size = header.comp_size;
+    stream->uncomp_size = header.uncomp_size;
+    stream->zip64 = 0;
+
+    // Zip64 extended information (id 0x0001) carries the real 64-bit sizes
+    unsigned char extra[65535];
+    if (!mz_zip_stream_read(stream, extra, header.extra_len)) return -1;
+    for (size_t pos = 0; pos + 4 <= header.extra_len;) {
+        uint16_t id, len;
+        memcpy(&id, extra + pos, 2);
+        memcpy(&len, extra + pos + 2, 2);
+        pos += 4;
+        if (id == 0x0001) {
+            size_t field = pos;
+            stream->zip64 = 1;
+            if (header.uncomp_size == 0xFFFFFFFF && field + 8 <= pos + len) {
+                memcpy(&stream->uncomp_size, extra + field, 8);
+                field += 8;
+            }
+            if (header.comp_size == 0xFFFFFFFF && field + 8 <= pos + len) {
+                memcpy(&stream->comp_size, extra + field, 8);
+            }
+        }
+        pos += len;
+    }
+
+    stream->pending = 1;
+    return 1;
+}
+
+// Inflate the current entry into out (NUL-terminated)
+int mz_zip_stream_extract(mz_zip_stream* stream, mz_zip_buffer* out) {
+    return stream->pending && mz_zip_stream_data(stream, out, NULL);
+}
+
+// Keep the current entry's compressed bytes for mz_zip_inflate_mem later
+int mz_zip_stream_read_raw(mz_zip_stream* stream, mz_zip_buffer* raw) {
+    return stream->pending && mz_zip_stream_data(stream, NULL, raw);
+}
+
+// Drain the rest of the input (central directory) so the writing side
+// does not see a broken pipe, then release the read-ahead buffer
+void mz_zip_stream_end(mz_zip_stream* stream) {
+    while (stream->buf && fread(stream->buf, 1, MZ_INFLATE_CHUNK, stream->file) > 0) {
+    }
+    free(stream->buf);
+    memset(stream, 0, sizeof(*stream));
+}
+
+// Inflate compressed entry bytes kept by mz_zip_stream_read_raw
+int mz_zip_inflate_mem(const void* comp, size_t comp_size, int method, mz_zip_buffer* out) {
+    out->size = 0;
+    if (method == 0) {
+        if (!mz_zip_buffer_append(out, comp, comp_size)) return 0;
+        out->data[out->size] = '\0';
+        return 1;
+    }
+    if (method != 8) return 0;
+
+    z_stream strm = {0};
+    if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) return 0;
+    strm.next_in = (Bytef*)comp;
+    strm.avail_in = comp_size;
+
+    int result = Z_OK;
+    while (result == Z_OK && !budget_poll()) {
+        if (!mz_zip_buffer_reserve(out, MZ_INFLATE_CHUNK)) break;
+        strm.next_out = (Bytef*)out->data + out->size;
+        strm.avail_out = MZ_INFLATE_CHUNK;
+        result = inflate(&strm, Z_NO_FLUSH);
+        out->size += MZ_INFLATE_CHUNK - strm.avail_out;
+    }
+    inflateEnd(&strm);
+    if (result != Z_STREAM_END) return 0;
+    out->data[out->size] = '\0';
+    return 1;
+}
 //*** MINIZ END
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+
+// *** NUMFMT
+// Number text shared by the .xlsb reader and the .xcol writer/reader, so a
+// double written as binary formats back to the same text as the TSV.
+
+// Shortest text that reads back as the same double, in plain notation for
+// exponents -4..15 and "1e-05"/"1.5e+16" outside it. That is the <v> text of
+// workbooks written with Python's repr (openpyxl, bench/gen_corpus.py), so an
+// .xlsb gives the same TSV as its .xlsx twin there. Excel serialises <v>
+// differently (e.g. "1E-5" with an uppercase E and no exponent padding).
+// Such cells come out with the same value but different text. No
+// Excel-saved workbooks were available to pin down Excel's exact rules.
+// out must hold at least 32 bytes.
+static inline void format_number(double value, char* out) {
+    // Integers: no rounding work at all
+    if (value > -1e15 && value < 1e15 && value == (double)(long long)value && !(value == 0 && signbit(value))) {
+        long long n = (long long)value;
+        char digits[24];
+        int len = 0;
+        unsigned long long u = n < 0 ? 0ULL - (unsigned long long)n : (unsigned long long)n;
+        do {
+            digits[len++] = (char)('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (n < 0) *out++ = '-';
+        while (len > 0) *out++ = digits[--len];
+        *out = '\0';
+        return;
+    }
+
+    // Every decimal with <= 15 significant digits survives a double round
+    // trip, so 15 digits with trailing zeros stripped is already shortest;
+    // only values needing 16 or 17 digits take another probe. Subnormals
+    // have fewer significant bits and search from 1 digit.
+    char buf[32];
+    for (int precision = fabs(value) < DBL_MIN ? 1 : 15; precision <= 17; precision++) {
+        snprintf(buf, sizeof(buf), "%.*e", precision - 1, value);
+        if (strtod(buf, NULL) == value) break;
+    }
+
+    // Split "-d.ddde+XX" into sign, digits and exponent
+    const char* p = buf;
+    bool negative = *p == '-';
+    if (negative) p++;
+    char digits[24];
+    int count = 0;
+    for (; *p && *p != 'e'; p++) {
+        if (*p != '.') digits[count++] = *p;
+    }
+    int exponent = *p == 'e' ? atoi(p + 1) : 0;
+    while (count > 1 && digits[count - 1] == '0') count--;
+
+    if (negative) *out++ = '-';
+    if (exponent < -4 || exponent >= 16) {
+        *out++ = digits[0];
+        if (count > 1) {
+            *out++ = '.';
+            memcpy(out, digits + 1, count - 1);
+            out += count - 1;
+        }
+        sprintf(out, "e%c%02d", exponent < 0 ? '-' : '+', abs(exponent));
+        return;
+    }
+    if (exponent < 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = -1; i > exponent; i--) *out++ = '0';
+        memcpy(out, digits, count);
+        out += count;
+    } else {
+        for (int i = 0; i <= exponent; i++) *out++ = i < count ? digits[i] : '0';
+        if (count > exponent + 1) {
+            *out++ = '.';
+            memcpy(out, digits + exponent + 1, count - exponent - 1);
+            out += count - exponent - 1;
+        }
+    }
+    *out = '\0';
+}
+// *** NUMFMT END
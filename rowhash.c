@@ -0,0 +1,199 @@
+// *** ROWHASH
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "rowhash.h"
+#include "fatal.h"
+
+#define ROWHASH_MAGIC "XRHS"
+#define ROWHASH_VERSION 1
+
+void row_hash_file_init(RowHashFile* file) {
+    memset(file, 0, sizeof(*file));
+}
+
+void row_hash_file_free(RowHashFile* file) {
+    for (int i = 0; i < file->count; i++) {
+        free(file->sheets[i].name);
+        free(file->sheets[i].hashes);
+    }
+    free(file->sheets);
+    memset(file, 0, sizeof(*file));
+}
+
+void row_hash_file_add(RowHashFile* file, const char* name, uint64_t* hashes, size_t count) {
+    if (file->count >= file->capacity) {
+        int capacity = file->capacity ? file->capacity * 2 : 8;
+        RowHashSheet* grown = realloc(file->sheets, sizeof(RowHashSheet) * capacity);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        file->sheets = grown;
+        file->capacity = capacity;
+    }
+
+    RowHashSheet* sheet = &file->sheets[file->count++];
+    sheet->name = strdup(name);
+    sheet->hashes = hashes;
+    sheet->count = count;
+}
+
+const RowHashSheet* row_hash_file_find(const RowHashFile* file, const char* name) {
+    for (int i = 0; i < file->count; i++) {
+        if (strcmp(file->sheets[i].name, name) == 0) return &file->sheets[i];
+    }
+    return NULL;
+}
+
+int row_hash_file_save(const RowHashFile* file, const char* filename) {
+    char tmp_filename[PATH_MAX];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    FILE* fp = fopen(tmp_filename, "wb");
+    if (!fp) return 0;
+
+    uint32_t version = ROWHASH_VERSION;
+    uint32_t sheet_count = (uint32_t)file->count;
+    int ok = fwrite(ROWHASH_MAGIC, 4, 1, fp) == 1 &&
+             fwrite(&version, sizeof(version), 1, fp) == 1 &&
+             fwrite(&sheet_count, sizeof(sheet_count), 1, fp) == 1;
+
+    for (int i = 0; ok && i < file->count; i++) {
+        const RowHashSheet* sheet = &file->sheets[i];
+        uint32_t name_len = (uint32_t)strlen(sheet->name);
+        uint64_t count = sheet->count;
+        ok = fwrite(&name_len, sizeof(name_len), 1, fp) == 1 &&
+             fwrite(sheet->name, name_len, 1, fp) == 1 &&
+             fwrite(&count, sizeof(count), 1, fp) == 1 &&
+             (count == 0 || fwrite(sheet->hashes, sizeof(uint64_t), count, fp) == count);
+    }
+
+    if (fclose(fp) != 0) ok = 0;
+    if (ok && rename(tmp_filename, filename) != 0) ok = 0;
+    if (!ok) remove(tmp_filename);
+    return ok;
+}
+
+int row_hash_file_load(RowHashFile* file, const char* filename) {
+    row_hash_file_init(file);
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) return 0;
+
+    char magic[4];
+    uint32_t version, sheet_count;
+    int ok = fread(magic, 4, 1, fp) == 1 && memcmp(magic, ROWHASH_MAGIC, 4) == 0 &&
+             fread(&version, sizeof(version), 1, fp) == 1 && version == ROWHASH_VERSION &&
+             fread(&sheet_count, sizeof(sheet_count), 1, fp) == 1;
+
+    for (uint32_t i = 0; ok && i < sheet_count; i++) {
+        uint32_t name_len;
+        uint64_t count;
+        char name[1024];
+        ok = fread(&name_len, sizeof(name_len), 1, fp) == 1 && name_len < sizeof(name) &&
+             fread(name, name_len, 1, fp) == 1 &&
+             fread(&count, sizeof(count), 1, fp) == 1;
+        if (!ok) break;
+        name[name_len] = '\0';
+
+        uint64_t* hashes = malloc(sizeof(uint64_t) * (count ? count : 1));
+        ok = hashes && (count == 0 || fread(hashes, sizeof(uint64_t), count, fp) == count);
+        if (!ok) {
+            free(hashes);
+            break;
+        }
+        row_hash_file_add(file, name, hashes, count);
+    }
+
+    fclose(fp);
+    if (!ok) row_hash_file_free(file);
+    return ok;
+}
+
+// LSD radix sort, 16 bits per pass; passes where every key shares the
+// digit are skipped
+void row_hash_sort(uint64_t* hashes, size_t count) {
+    if (count < 2) return;
+    uint64_t* tmp = malloc(sizeof(uint64_t) * count);
+    size_t* histogram = calloc(4 * 65536, sizeof(size_t));
+    if (!tmp || !histogram) {
+        fatal_error("Memory allocation failed");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t h = hashes[i];
+        for (int pass = 0; pass < 4; pass++) {
+            histogram[pass * 65536 + ((h >> (pass * 16)) & 0xFFFF)]++;
+        }
+    }
+
+    uint64_t* src = hashes;
+    uint64_t* dst = tmp;
+    for (int pass = 0; pass < 4; pass++) {
+        size_t* counts = &histogram[pass * 65536];
+        if (counts[(src[0] >> (pass * 16)) & 0xFFFF] == count) continue;
+
+        size_t offset = 0;
+        for (int d = 0; d < 65536; d++) {
+            size_t n = counts[d];
+            counts[d] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dst[counts[(src[i] >> (pass * 16)) & 0xFFFF]++] = src[i];
+        }
+        uint64_t* swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != hashes) memcpy(hashes, src, sizeof(uint64_t) * count);
+    free(histogram);
+    free(tmp);
+}
+
+int row_hash_table_init(RowHashTable* table, const uint64_t* hashes, size_t count) {
+    // Power of two with load factor <= 1/2
+    size_t capacity = 64;
+    while (capacity < count * 2) capacity *= 2;
+    table->keys = malloc(sizeof(uint64_t) * capacity);
+    table->counts = calloc(capacity, sizeof(uint32_t));
+    table->mask = capacity - 1;
+    if (!table->keys || !table->counts) {
+        row_hash_table_free(table);
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t slot = hashes[i] & table->mask;
+        while (table->counts[slot] && table->keys[slot] != hashes[i]) {
+            slot = (slot + 1) & table->mask;
+        }
+        if (!table->counts[slot]) {
+            table->keys[slot] = hashes[i];
+            table->counts[slot] = 1;
+        }
+        table->counts[slot]++;
+    }
+    return 1;
+}
+
+void row_hash_table_free(RowHashTable* table) {
+    free(table->keys);
+    free(table->counts);
+    memset(table, 0, sizeof(*table));
+}
+
+bool row_hash_table_take(RowHashTable* table, uint64_t hash) {
+    size_t slot = hash & table->mask;
+    while (table->counts[slot]) {
+        if (table->keys[slot] == hash) {
+            if (table->counts[slot] == 1) return false;
+            table->counts[slot]--;
+            return true;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+    return false;
+}
+// *** ROWHASH END
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// *** ROWHASH
+// Row fingerprints for --diff-against. A .rowhash file keeps, per sheet,
+// the sorted 64-bit hashes of every emitted data row of the previous run.
+// While converting, the previous hashes sit in an open-addressing multiset
+// (one probe per row on average); rows not found there are added rows, and
+// hashes left over at the end are removed rows.
+
+typedef struct {
+    char* name;
+    uint64_t* hashes;       // sorted
+    size_t count;
+} RowHashSheet;
+
+typedef struct {
+    RowHashSheet* sheets;
+    int count;
+    int capacity;
+} RowHashFile;
+
+void row_hash_file_init(RowHashFile* file);
+void row_hash_file_free(RowHashFile* file);
+// 0 if the file is missing or not a .rowhash file (file is left empty)
+int row_hash_file_load(RowHashFile* file, const char* filename);
+// Written to <filename>.tmp and renamed, so filename may be the loaded file
+int row_hash_file_save(const RowHashFile* file, const char* filename);
+const RowHashSheet* row_hash_file_find(const RowHashFile* file, const char* name);
+// Takes ownership of hashes (sorted, malloc'd)
+void row_hash_file_add(RowHashFile* file, const char* name, uint64_t* hashes, size_t count);
+
+void row_hash_sort(uint64_t* hashes, size_t count);
+
+typedef struct {
+    uint64_t* keys;
+    uint32_t* counts;       // occurrences + 1; 0 = empty slot
+    size_t mask;
+} RowHashTable;
+
+int row_hash_table_init(RowHashTable* table, const uint64_t* hashes, size_t count);
+void row_hash_table_free(RowHashTable* table);
+// Consume one occurrence of hash; false if none is left (an added row)
+bool row_hash_table_take(RowHashTable* table, uint64_t hash);
+// *** ROWHASH END
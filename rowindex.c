@@ -0,0 +1,155 @@
+// *** ROWINDEX
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rowindex.h"
+#include "fatal.h"
+
+#define ROWIDX_MAGIC "XRIX"
+#define ROWIDX_VERSION 1
+
+void row_index_init(RowIndex* index, uint32_t crc32, uint64_t comp_size, uint64_t uncomp_size) {
+    memset(index, 0, sizeof(*index));
+    index->crc32 = crc32;
+    index->comp_size = comp_size;
+    index->uncomp_size = uncomp_size;
+}
+
+void row_index_free(RowIndex* index) {
+    for (int i = 0; i < index->count; i++) {
+        free(index->points[i].window);
+    }
+    free(index->points);
+    index->points = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+void row_index_add(RowIndex* index, int row, uint64_t row_out, uint64_t out, uint64_t in, int bits,
+                   const unsigned char* window, uint32_t window_len) {
+    if (index->count >= index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 64;
+        RowCheckpoint* grown = realloc(index->points, sizeof(RowCheckpoint) * capacity);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        index->points = grown;
+        index->capacity = capacity;
+    }
+
+    RowCheckpoint* point = &index->points[index->count++];
+    point->row = row;
+    point->row_out = row_out;
+    point->out = out;
+    point->in = in;
+    point->bits = bits;
+    point->window_len = window_len;
+    point->window = NULL;
+    if (window_len > 0) {
+        point->window = malloc(window_len);
+        if (!point->window) {
+            fatal_error("Memory allocation failed");
+        }
+        memcpy(point->window, window, window_len);
+    }
+}
+
+const RowCheckpoint* row_index_find(const RowIndex* index, int row) {
+    // Checkpoints are in row order: binary search for the last one <= row
+    int lo = 0, hi = index->count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (index->points[mid].row <= row) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0) {
+        return index->count > 0 ? &index->points[0] : NULL;
+    }
+    return &index->points[found];
+}
+
+int row_index_save(const RowIndex* index, const char* filename) {
+    char tmp_filename[PATH_MAX];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    FILE* fp = fopen(tmp_filename, "wb");
+    if (!fp) return 0;
+
+    uint32_t version = ROWIDX_VERSION;
+    uint32_t count = (uint32_t)index->count;
+    int ok = fwrite(ROWIDX_MAGIC, 4, 1, fp) == 1 &&
+             fwrite(&version, sizeof(version), 1, fp) == 1 &&
+             fwrite(&index->crc32, sizeof(index->crc32), 1, fp) == 1 &&
+             fwrite(&index->comp_size, sizeof(index->comp_size), 1, fp) == 1 &&
+             fwrite(&index->uncomp_size, sizeof(index->uncomp_size), 1, fp) == 1 &&
+             fwrite(&count, sizeof(count), 1, fp) == 1;
+
+    for (int i = 0; ok && i < index->count; i++) {
+        const RowCheckpoint* point = &index->points[i];
+        int32_t row = point->row;
+        uint8_t bits = (uint8_t)point->bits;
+        ok = fwrite(&row, sizeof(row), 1, fp) == 1 &&
+             fwrite(&point->row_out, sizeof(point->row_out), 1, fp) == 1 &&
+             fwrite(&point->out, sizeof(point->out), 1, fp) == 1 &&
+             fwrite(&point->in, sizeof(point->in), 1, fp) == 1 &&
+             fwrite(&bits, sizeof(bits), 1, fp) == 1 &&
+             fwrite(&point->window_len, sizeof(point->window_len), 1, fp) == 1 &&
+             (point->window_len == 0 || fwrite(point->window, point->window_len, 1, fp) == 1);
+    }
+
+    if (fclose(fp) != 0) ok = 0;
+    if (ok && rename(tmp_filename, filename) != 0) ok = 0;
+    if (!ok) remove(tmp_filename);
+    return ok;
+}
+
+int row_index_load(RowIndex* index, const char* filename) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) return 0;
+
+    char magic[4];
+    uint32_t version, count;
+    RowIndex loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    int ok = fread(magic, 4, 1, fp) == 1 && memcmp(magic, ROWIDX_MAGIC, 4) == 0 &&
+             fread(&version, sizeof(version), 1, fp) == 1 && version == ROWIDX_VERSION &&
+             fread(&loaded.crc32, sizeof(loaded.crc32), 1, fp) == 1 &&
+             fread(&loaded.comp_size, sizeof(loaded.comp_size), 1, fp) == 1 &&
+             fread(&loaded.uncomp_size, sizeof(loaded.uncomp_size), 1, fp) == 1 &&
+             fread(&count, sizeof(count), 1, fp) == 1;
+
+    unsigned char* window = malloc(ROWIDX_WINDOW);
+    if (!window) ok = 0;  // treated like a missing index
+    for (uint32_t i = 0; ok && i < count; i++) {
+        int32_t row;
+        uint8_t bits;
+        uint32_t window_len;
+        uint64_t row_out, out, in;
+        ok = fread(&row, sizeof(row), 1, fp) == 1 &&
+             fread(&row_out, sizeof(row_out), 1, fp) == 1 &&
+             fread(&out, sizeof(out), 1, fp) == 1 &&
+             fread(&in, sizeof(in), 1, fp) == 1 &&
+             fread(&bits, sizeof(bits), 1, fp) == 1 &&
+             fread(&window_len, sizeof(window_len), 1, fp) == 1 &&
+             window_len <= ROWIDX_WINDOW && bits < 8 &&
+             (window_len == 0 || fread(window, window_len, 1, fp) == 1);
+        if (ok) {
+            row_index_add(&loaded, row, row_out, out, in, bits, window, window_len);
+        }
+    }
+    free(window);
+    fclose(fp);
+
+    if (!ok) {
+        row_index_free(&loaded);
+        return 0;
+    }
+    *index = loaded;
+    return 1;
+}
+// *** ROWINDEX END
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// *** ROWINDEX
+// Sidecar row index (<Sheet>.rowidx) for random row access into a deflated
+// worksheet. Each checkpoint is a deflate block boundary (compressed offset,
+// unused bits and the preceding 32 KB window, as in zlib's zran example)
+// plus the first row that starts after it. Checkpoints are kept roughly
+// every ROWIDX_INTERVAL rows.
+
+#define ROWIDX_WINDOW 32768
+#define ROWIDX_INTERVAL 10000
+
+typedef struct {
+    int row;                // first row (0-based) whose <row> tag starts at/after out
+    uint64_t row_out;       // uncompressed offset of that <row> tag
+    uint64_t out;           // uncompressed offset of the access point
+    uint64_t in;            // compressed offset into the entry data
+    int bits;               // unused bits of the byte before in (0-7)
+    uint32_t window_len;
+    unsigned char* window;  // uncompressed bytes preceding out
+} RowCheckpoint;
+
+typedef struct {
+    // Identify the worksheet entry the index was built from
+    uint32_t crc32;
+    uint64_t comp_size;
+    uint64_t uncomp_size;
+
+    RowCheckpoint* points;
+    int count;
+    int capacity;
+} RowIndex;
+
+void row_index_init(RowIndex* index, uint32_t crc32, uint64_t comp_size, uint64_t uncomp_size);
+void row_index_free(RowIndex* index);
+void row_index_add(RowIndex* index, int row, uint64_t row_out, uint64_t out, uint64_t in, int bits,
+                   const unsigned char* window, uint32_t window_len);
+// Last checkpoint at or before row, or NULL if the index is empty
+const RowCheckpoint* row_index_find(const RowIndex* index, int row);
+int row_index_save(const RowIndex* index, const char* filename);
+int row_index_load(RowIndex* index, const char* filename);
+// *** ROWINDEX END
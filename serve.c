@@ -0,0 +1,358 @@
+// *** SERVE
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "serve.h"
+
+// One client connection. The main thread reads request lines into buf and
+// hands them to the workers one at a time (busy), so replies keep request
+// order and an idle connection does not hold a worker.
+typedef struct {
+    int fd;
+    char buf[SERVE_MAX_LINE];   // received bytes not yet handed to a worker
+    size_t len;
+    char line[SERVE_MAX_LINE];  // request line of the job in the queue or running
+    bool busy;                  // line is queued or running (guarded by queue.lock)
+    bool discard;               // skipping the rest of an overlong line
+    bool eof;                   // client closed its side
+} ServeClient;
+
+// Bounded queue of request lines (their clients)
+static struct {
+    ServeClient* jobs[SERVE_QUEUE_SIZE];
+    int head;
+    int count;
+    bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+} queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+// Workers (job done) and the signal handler wake the main thread's poll here
+static int wake_fds[2] = { -1, -1 };
+
+typedef struct {
+    ServeContextCreate create;
+    ServeContextDestroy destroy;
+    ServeJobHandler handler;
+} ServeWorker;
+
+static void wake_main(void) {
+    ssize_t written = write(wake_fds[1], "", 1);  // a full pipe is already a pending wake-up
+    (void)written;
+}
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+    wake_main();
+}
+
+// Queue the client's next request line; false when the queue is full
+static bool queue_try_push(ServeClient* client) {
+    pthread_mutex_lock(&queue.lock);
+    bool pushed = queue.count < SERVE_QUEUE_SIZE;
+    if (pushed) {
+        queue.jobs[(queue.head + queue.count) % SERVE_QUEUE_SIZE] = client;
+        queue.count++;
+        client->busy = true;
+        pthread_cond_signal(&queue.not_empty);
+    }
+    pthread_mutex_unlock(&queue.lock);
+    return pushed;
+}
+
+// Returns NULL once the server is stopping
+static ServeClient* queue_pop(void) {
+    pthread_mutex_lock(&queue.lock);
+    while (queue.count == 0 && !queue.stopping) {
+        pthread_cond_wait(&queue.not_empty, &queue.lock);
+    }
+    ServeClient* client = NULL;
+    if (queue.count > 0 && !queue.stopping) {
+        client = queue.jobs[queue.head];
+        queue.head = (queue.head + 1) % SERVE_QUEUE_SIZE;
+        queue.count--;
+    }
+    pthread_mutex_unlock(&queue.lock);
+    return client;
+}
+
+static bool client_busy(ServeClient* client) {
+    pthread_mutex_lock(&queue.lock);
+    bool busy = client->busy;
+    pthread_mutex_unlock(&queue.lock);
+    return busy;
+}
+
+static void* worker_main(void* arg) {
+    ServeWorker* worker = arg;
+    void* ctx = worker->create();
+
+    ServeClient* client;
+    while ((client = queue_pop()) != NULL) {
+        // Replies go straight to the socket, one line at a time (fdopen would
+        // buffer them fully), so a client sees each sheet as it finishes
+        int out_fd = dup(client->fd);
+        FILE* out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+        if (out) {
+            setvbuf(out, NULL, _IOLBF, 0);
+            worker->handler(ctx, client->line, out);
+            fclose(out);
+        } else if (out_fd >= 0) {
+            close(out_fd);
+        }
+
+        pthread_mutex_lock(&queue.lock);
+        client->busy = false;
+        pthread_mutex_unlock(&queue.lock);
+        wake_main();
+    }
+
+    worker->destroy(ctx);
+    return NULL;
+}
+
+// Move the next request line of an idle client to its job slot and queue it
+static void dispatch_line(ServeClient* client) {
+    while (!client_busy(client)) {
+        char* newline = memchr(client->buf, '\n', client->len);
+        size_t len;
+        size_t consumed;
+        if (newline) {
+            len = (size_t)(newline - client->buf);
+            consumed = len + 1;
+        } else if (client->len == sizeof(client->buf) || (client->eof && client->len > 0)) {
+            // Overlong line (the rest is skipped up to its newline) or unterminated last line
+            len = client->len < sizeof(client->buf) ? client->len : sizeof(client->buf) - 1;
+            consumed = client->len;
+            client->discard = !client->eof;
+        } else {
+            return;
+        }
+
+        memcpy(client->line, client->buf, len);
+        client->line[len] = '\0';
+        while (len > 0 && client->line[len - 1] == '\r') client->line[--len] = '\0';
+        if (len > 0 && !queue_try_push(client)) return;  // queue full: retried on the next wake-up
+
+        memmove(client->buf, client->buf + consumed, client->len - consumed);
+        client->len -= consumed;
+    }
+}
+
+// Read what the client has sent; sets eof when it has closed its side
+static void read_client(ServeClient* client) {
+    ssize_t n = read(client->fd, client->buf + client->len, sizeof(client->buf) - client->len);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return;
+    if (n <= 0) {
+        client->eof = true;
+        return;
+    }
+    size_t start = client->len;
+    client->len += (size_t)n;
+    if (client->discard) {
+        char* newline = memchr(client->buf + start, '\n', client->len - start);
+        size_t keep = newline ? client->len - (size_t)(newline + 1 - client->buf) : 0;
+        memmove(client->buf, client->buf + client->len - keep, keep);
+        client->len = keep;
+        client->discard = newline == NULL;
+    }
+}
+
+// Unlink the socket file if it is still the one this server bound
+// (created), not one another server has since put at the same path
+static void remove_socket(const char* socket_path, const struct stat* created) {
+    struct stat st;
+    if (created && lstat(socket_path, &st) == 0 && st.st_dev == created->st_dev && st.st_ino == created->st_ino) {
+        unlink(socket_path);
+    }
+}
+
+int serve_run(const char* socket_path, int worker_count,
+              ServeContextCreate create, ServeContextDestroy destroy,
+              ServeJobHandler handler) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        printf("Error: Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        printf("Error: Could not create socket: %s\n", strerror(errno));
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    // Replace a stale socket left by an earlier server, but never another file
+    struct stat st;
+    if (lstat(socket_path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            printf("Error: %s exists and is not a socket\n", socket_path);
+            close(listen_fd);
+            return 1;
+        }
+        unlink(socket_path);
+    }
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        printf("Error: Could not listen on %s: %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return 1;
+    }
+    // Identity of the socket this process created, checked before removing it
+    struct stat created;
+    bool have_created = stat(socket_path, &created) == 0;
+    if (listen(listen_fd, SERVE_QUEUE_SIZE) < 0) {
+        printf("Error: Could not listen on %s: %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        remove_socket(socket_path, have_created ? &created : NULL);
+        return 1;
+    }
+    if (pipe(wake_fds) < 0) {
+        printf("Error: Could not create pipe: %s\n", strerror(errno));
+        close(listen_fd);
+        remove_socket(socket_path, have_created ? &created : NULL);
+        return 1;
+    }
+    fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    ServeWorker worker = { create, destroy, handler };
+    pthread_t* threads = malloc(sizeof(pthread_t) * worker_count);
+    ServeClient** clients = calloc(SERVE_MAX_CLIENTS, sizeof(ServeClient*));
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * (SERVE_MAX_CLIENTS + 2));
+    ServeClient** polled = malloc(sizeof(ServeClient*) * (SERVE_MAX_CLIENTS + 2));
+    if (!threads || !clients || !fds || !polled) {
+        printf("Error: Memory allocation failed\n");
+        free(threads);
+        free(clients);
+        free(fds);
+        free(polled);
+        close(wake_fds[0]);
+        close(wake_fds[1]);
+        close(listen_fd);
+        remove_socket(socket_path, have_created ? &created : NULL);
+        return 1;
+    }
+    for (int i = 0; i < worker_count; i++) {
+        pthread_create(&threads[i], NULL, worker_main, &worker);
+    }
+
+    printf("Serving on %s with %d worker(s)\n", socket_path, worker_count);
+    fflush(stdout);
+
+    int client_count = 0;
+    while (!stop_requested) {
+        // Queue waiting lines, close finished clients, then poll for more
+        int nfds = 0;
+        for (int i = 0; i < client_count; i++) {
+            ServeClient* client = clients[i];
+            dispatch_line(client);
+            if (client->eof && client->len == 0 && !client_busy(client)) {
+                close(client->fd);
+                free(client);
+                clients[i--] = clients[--client_count];
+                continue;
+            }
+            if (!client->eof && client->len < sizeof(client->buf)) {
+                fds[nfds] = (struct pollfd){ client->fd, POLLIN, 0 };
+                polled[nfds++] = client;
+            }
+        }
+        fds[nfds] = (struct pollfd){ wake_fds[0], POLLIN, 0 };
+        polled[nfds++] = NULL;
+        if (client_count < SERVE_MAX_CLIENTS) {
+            fds[nfds] = (struct pollfd){ listen_fd, POLLIN, 0 };
+            polled[nfds++] = NULL;
+        }
+
+        if (poll(fds, (nfds_t)nfds, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Warning: poll failed: %s\n", strerror(errno));
+            continue;
+        }
+
+        for (int i = 0; i < nfds; i++) {
+            if (!fds[i].revents) continue;
+            if (polled[i]) {
+                read_client(polled[i]);
+            } else if (fds[i].fd == wake_fds[0]) {
+                char drain[64];
+                while (read(wake_fds[0], drain, sizeof(drain)) > 0) {
+                }
+            } else {
+                int client_fd = accept(listen_fd, NULL, NULL);
+                if (client_fd < 0) {
+                    if (errno != EINTR) fprintf(stderr, "Warning: accept failed: %s\n", strerror(errno));
+                    continue;
+                }
+                ServeClient* client = malloc(sizeof(ServeClient));
+                if (!client) {
+                    close(client_fd);
+                    continue;
+                }
+                client->fd = client_fd;
+                client->len = 0;
+                client->busy = false;
+                client->discard = false;
+                client->eof = false;
+                clients[client_count++] = client;
+            }
+        }
+    }
+
+    // Running jobs finish, queued ones are dropped; shutting the sockets down
+    // ends replies blocked on clients that stopped reading
+    printf("Shutting down...\n");
+    pthread_mutex_lock(&queue.lock);
+    queue.stopping = true;
+    queue.count = 0;
+    pthread_cond_broadcast(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+    for (int i = 0; i < client_count; i++) {
+        shutdown(clients[i]->fd, SHUT_RDWR);
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < client_count; i++) {
+        close(clients[i]->fd);
+        free(clients[i]);
+    }
+    free(clients);
+    free(fds);
+    free(polled);
+    free(threads);
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    close(listen_fd);
+    remove_socket(socket_path, have_created ? &created : NULL);
+    return 0;
+}
+// *** SERVE END
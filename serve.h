@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+
+// *** SERVE
+// Line-oriented Unix socket server with a fixed pool of worker threads.
+// Each worker owns a context created once at startup (warm buffers). The
+// main thread polls the connections and queues single request lines; a
+// worker passes one to the job handler together with a stream for the
+// reply. A connection has one line in progress at a time, so its replies
+// come in request order, and idle connections hold no worker.
+
+#define SERVE_MAX_LINE 8192
+#define SERVE_QUEUE_SIZE 64
+#define SERVE_MAX_CLIENTS 256
+
+typedef void* (*ServeContextCreate)(void);
+typedef void (*ServeContextDestroy)(void* ctx);
+// Handle one request line (without trailing newline); write reply to out
+typedef void (*ServeJobHandler)(void* ctx, char* line, FILE* out);
+
+// Runs until SIGINT/SIGTERM; returns 0 on clean shutdown, 1 on setup failure
+int serve_run(const char* socket_path, int worker_count,
+              ServeContextCreate create, ServeContextDestroy destroy,
+              ServeJobHandler handler);
+// *** SERVE END
@@ -0,0 +1,48 @@
+#!/bin/sh
+# Regression test for --diff-against: an unchanged workbook gives an empty
+# delta, and a filtered run (--where, --rows) is rejected without touching
+# the saved row hashes.
+# Usage: sh tests/diff_against.sh
+set -e
+cd "$(dirname "$0")/.."
+
+WORK_DIR=tests/out/diff_against
+BIN=$(pwd)/xlsx_to_tsv
+
+make -s xlsx_to_tsv
+rm -rf "$WORK_DIR" && mkdir -p "$WORK_DIR"
+
+python3 - "$WORK_DIR/book.xlsx" <<'PY'
+import sys
+sys.path.insert(0, "bench")
+from gen_corpus import Workbook, header
+
+wb = Workbook()
+rows = [header(["ID", "Code"])]
+rows += [[(0, r), (1, "C%d" % (r % 3))] for r in range(100)]
+wb.add_sheet("Data", rows)
+wb.save(sys.argv[1])
+PY
+
+fail() {
+    echo "FAIL: $1" >&2
+    exit 1
+}
+
+cd "$WORK_DIR"
+"$BIN" book.xlsx --diff-against=data.rowhash > /dev/null
+[ "$(grep -c '^+' Data.delta.tsv)" -eq 100 ] || fail "first run should add every row"
+cp data.rowhash saved.rowhash
+
+for filter in --where=Code=C1 --rows=10:20; do
+    if "$BIN" book.xlsx --diff-against=data.rowhash "$filter" > log.txt; then
+        fail "$filter with --diff-against should be rejected"
+    fi
+    grep -q "cannot be combined" log.txt || fail "$filter: no error message"
+    cmp -s data.rowhash saved.rowhash || fail "$filter overwrote the saved row hashes"
+done
+
+"$BIN" book.xlsx --diff-against=data.rowhash > /dev/null
+[ "$(wc -l < Data.delta.tsv)" -eq 1 ] || fail "unchanged workbook should give an empty delta"
+
+echo "diff_against: ok"
@@ -0,0 +1,344 @@
+// *** URING_IO
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "uring_io.h"
+#include "fatal.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+
+#ifdef HAVE_IO_URING
+
+// One in-flight write; user_data of the SQE is the slot index
+typedef struct {
+    int fd;
+    char* buf;
+    size_t len;
+    size_t done;
+    off_t offset;
+    bool busy;
+} UringRequest;
+
+// One ring per thread (each --serve worker gets its own)
+static _Thread_local struct {
+    int ring_fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ptr;
+    void* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+
+    UringRequest requests[URING_IO_DEPTH];
+    int in_flight;
+
+    // Recycled buffers
+    char* free_buffers[URING_IO_DEPTH + 1];
+    int free_count;
+
+    // First failed write, raised by the next uring_io_* call of the conversion
+    char error[128];
+} ring = { .ring_fd = -1 };
+
+// Unmap and close the ring without waiting. Buffers still in flight are
+// left to the kernel (only after a failed io_uring_enter).
+static void ring_close(void) {
+    munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq_ptr != ring.sq_ptr) munmap(ring.cq_ptr, ring.cq_size);
+    munmap(ring.sq_ptr, ring.sq_size);
+    close(ring.ring_fd);
+    ring.ring_fd = -1;
+
+    for (int i = 0; i < URING_IO_DEPTH; i++) {
+        ring.requests[i].busy = false;
+    }
+    ring.in_flight = 0;
+}
+
+static void raise_error(void) {
+    if (!ring.error[0]) return;
+    char message[sizeof(ring.error)];
+    memcpy(message, ring.error, sizeof(message));
+    ring.error[0] = '\0';
+    fatal_error("%s", message);
+}
+
+static void record_error(const char* what, int err) {
+    if (ring.error[0]) return;
+    if (err) {
+        snprintf(ring.error, sizeof(ring.error), "%s: %s", what, strerror(err));
+    } else {
+        snprintf(ring.error, sizeof(ring.error), "%s", what);
+    }
+}
+
+// false if the kernel did not take the SQE
+static bool queue_write(int slot) {
+    UringRequest* req = &ring.requests[slot];
+    unsigned tail = *ring.sq_tail;
+    unsigned index = tail & *ring.sq_mask;
+    struct io_uring_sqe* sqe = &ring.sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = req->fd;
+    sqe->addr = (unsigned long)(req->buf + req->done);
+    sqe->len = (unsigned)(req->len - req->done);
+    sqe->off = (unsigned long long)(req->offset + req->done);
+    sqe->user_data = (unsigned long long)slot;
+
+    ring.sq_array[index] = index;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (syscall(__NR_io_uring_enter, ring.ring_fd, 1, 0, 0, NULL, 0) < 0) {
+        record_error("io_uring submit failed", errno);
+        return false;
+    }
+    return true;
+}
+
+void uring_io_release_buffer(char* buf) {
+    if (ring.free_count < URING_IO_DEPTH + 1) {
+        ring.free_buffers[ring.free_count++] = buf;
+    } else {
+        free(buf);
+    }
+}
+
+// Retire a request; its buffer goes back to the pool
+static void complete_request(UringRequest* req) {
+    uring_io_release_buffer(req->buf);
+    req->busy = false;
+    ring.in_flight--;
+}
+
+// Process every available completion; optionally block for at least one.
+// Failed writes are recorded for raise_error. false if the ring is unusable
+// (it has been closed).
+static bool reap_completions(bool wait) {
+    if (ring.ring_fd < 0) return false;
+    if (wait) {
+        if (syscall(__NR_io_uring_enter, ring.ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+            errno != EINTR) {
+            record_error("io_uring wait failed", errno);
+            ring_close();
+            return false;
+        }
+    }
+
+    unsigned head = *ring.cq_head;
+    while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+        int slot = (int)cqe->user_data;
+        int res = cqe->res;
+        head++;
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+        UringRequest* req = &ring.requests[slot];
+        if (res < 0) {
+            record_error("async write failed", -res);
+            complete_request(req);
+            continue;
+        }
+        req->done += (size_t)res;
+
+        if (res > 0 && req->done < req->len) {
+            // Short write: resubmit the remainder
+            if (!queue_write(slot)) {
+                ring_close();
+                return false;
+            }
+            continue;
+        }
+        if (req->done < req->len) record_error("async write made no progress", 0);
+        complete_request(req);
+    }
+    return true;
+}
+
+// IORING_OP_WRITE came with 5.6, after io_uring itself (5.1): ask the
+// kernel. IORING_REGISTER_PROBE is from 5.6 too, so a failed probe means no
+// write opcode either.
+static bool ring_supports_write(int fd) {
+#ifdef IO_URING_OP_SUPPORTED
+    enum { PROBE_OPS = 256 };
+    struct io_uring_probe* probe = calloc(1, sizeof(*probe) + PROBE_OPS * sizeof(struct io_uring_probe_op));
+    if (!probe) return false;
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) >= 0 &&
+                     probe->last_op >= IORING_OP_WRITE &&
+                     (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return supported;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+int uring_io_init(void) {
+    if (ring.ring_fd >= 0) return 1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, URING_IO_DEPTH, &params);
+    if (fd < 0) return 0;
+    if (!ring_supports_write(fd)) {
+        close(fd);
+        return 0;
+    }
+
+    ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        if (ring.cq_size > ring.sq_size) ring.sq_size = ring.cq_size;
+        ring.cq_size = ring.sq_size;
+    }
+
+    ring.sq_ptr = mmap(NULL, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ptr == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+
+    if (single_mmap) {
+        ring.cq_ptr = ring.sq_ptr;
+    } else {
+        ring.cq_ptr = mmap(NULL, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ptr == MAP_FAILED) {
+            munmap(ring.sq_ptr, ring.sq_size);
+            close(fd);
+            return 0;
+        }
+    }
+
+    ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) {
+        if (!single_mmap) munmap(ring.cq_ptr, ring.cq_size);
+        munmap(ring.sq_ptr, ring.sq_size);
+        close(fd);
+        return 0;
+    }
+
+    char* sq = ring.sq_ptr;
+    char* cq = ring.cq_ptr;
+    ring.sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring.sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring.sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring.cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring.cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring.cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    ring.ring_fd = fd;
+    ring.in_flight = 0;
+    return 1;
+}
+
+void uring_io_exit(void) {
+    uring_io_discard();
+    if (ring.ring_fd >= 0) ring_close();
+
+    for (int i = 0; i < ring.free_count; i++) {
+        free(ring.free_buffers[i]);
+    }
+    ring.free_count = 0;
+}
+
+bool uring_io_enabled(void) {
+    return ring.ring_fd >= 0;
+}
+
+char* uring_io_get_buffer(void) {
+    reap_completions(false);
+    raise_error();
+    if (ring.free_count > 0) {
+        return ring.free_buffers[--ring.free_count];
+    }
+
+    char* buf = malloc(URING_IO_BUFFER_SIZE);
+    if (!buf) {
+        fatal_error("Memory allocation failed");
+    }
+    return buf;
+}
+
+void uring_io_submit(int fd, char* buf, size_t len, off_t offset) {
+    if (len == 0) {
+        uring_io_release_buffer(buf);
+        return;
+    }
+
+    // Bound the number of writes in flight
+    while (ring.in_flight >= URING_IO_DEPTH && reap_completions(true)) {
+    }
+    raise_error();
+
+    int slot = 0;
+    while (ring.requests[slot].busy) slot++;
+
+    UringRequest* req = &ring.requests[slot];
+    req->fd = fd;
+    req->buf = buf;
+    req->len = len;
+    req->done = 0;
+    req->offset = offset;
+    req->busy = true;
+    ring.in_flight++;
+
+    if (!queue_write(slot)) {
+        req->busy = false;  // buf stays the caller's
+        ring.in_flight--;
+        ring_close();
+        raise_error();
+    }
+}
+
+void uring_io_drain(void) {
+    while (ring.in_flight > 0 && reap_completions(true)) {
+    }
+    raise_error();
+}
+
+void uring_io_discard(void) {
+    while (ring.in_flight > 0 && reap_completions(true)) {
+    }
+    ring.error[0] = '\0';
+}
+
+#else // !HAVE_IO_URING
+
+int uring_io_init(void) { return 0; }
+void uring_io_exit(void) {}
+bool uring_io_enabled(void) { return false; }
+char* uring_io_get_buffer(void) { return NULL; }
+void uring_io_release_buffer(char* buf) { free(buf); }
+void uring_io_submit(int fd, char* buf, size_t len, off_t offset) {
+    (void)fd; (void)buf; (void)len; (void)offset;
+}
+void uring_io_drain(void) {}
+void uring_io_discard(void) {}
+
+#endif
+// *** URING_IO END
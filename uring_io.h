@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// *** URING_IO
+// Optional io_uring write backend for Filter output.
+// Full output buffers are handed to the kernel as async writes; the parser
+// keeps filling the next buffer while earlier ones are still in flight.
+// If io_uring is not available, or the kernel lacks IORING_OP_WRITE
+// (before 5.6), uring_io_init() fails and callers keep using the
+// synchronous write() path.
+
+#define URING_IO_DEPTH 8                // max writes in flight
+#define URING_IO_BUFFER_SIZE (256 * 1024)
+
+int uring_io_init(void);                // 1 on success, 0 if io_uring unavailable
+void uring_io_exit(void);
+bool uring_io_enabled(void);
+
+// Get a free output buffer (waits for a completion if all are in flight)
+char* uring_io_get_buffer(void);
+// Return an unused buffer to the pool
+void uring_io_release_buffer(char* buf);
+// Queue buf[0..len) for writing at offset; buf is recycled on completion.
+// A failed write is raised with fatal_error by the next call of these
+void uring_io_submit(int fd, char* buf, size_t len, off_t offset);
+// Wait until every queued write has completed
+void uring_io_drain(void);
+// Like uring_io_drain, but forget failed writes (the conversion is abandoned)
+void uring_io_discard(void);
+// *** URING_IO END
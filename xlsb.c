@@ -0,0 +1,261 @@
+// *** XLSB
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "xlsb.h"
+#include "numfmt.h"
+
+// Record types used here ([MS-XLSB] 2.3)
+#define BRT_ROW_HDR        0
+#define BRT_CELL_BLANK     1
+#define BRT_CELL_RK        2
+#define BRT_CELL_ERROR     3
+#define BRT_CELL_BOOL      4
+#define BRT_CELL_REAL      5
+#define BRT_CELL_ST        6
+#define BRT_CELL_ISST      7
+#define BRT_FMLA_STRING    8
+#define BRT_FMLA_NUM       9
+#define BRT_FMLA_BOOL      10
+#define BRT_FMLA_ERROR     11
+#define BRT_SST_ITEM       19
+#define BRT_BUNDLE_SH      156
+
+#define XLSB_MAX_STRING 32768
+
+typedef struct {
+    const unsigned char* pos;
+    const unsigned char* end;
+} XlsbReader;
+
+static inline uint32_t read_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Record header: type and size are 7-bit varints (2 and 4 bytes max)
+static int next_record(XlsbReader* reader, uint32_t* type, const unsigned char** body, uint32_t* len) {
+    const unsigned char* p = reader->pos;
+    uint32_t value = 0;
+    for (int i = 0; i < 2; i++) {
+        if (p >= reader->end) return 0;
+        value |= (uint32_t)(*p & 0x7F) << (7 * i);
+        if (!(*p++ & 0x80)) break;
+    }
+    *type = value;
+
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        if (p >= reader->end) return 0;
+        value |= (uint32_t)(*p & 0x7F) << (7 * i);
+        if (!(*p++ & 0x80)) break;
+    }
+    if ((size_t)(reader->end - p) < value) return 0;
+
+    *body = p;
+    *len = value;
+    reader->pos = p + value;
+    return 1;
+}
+
+// XLWideString (u32 character count + UTF-16LE) to UTF-8; returns bytes consumed or 0
+static size_t read_wide_string(const unsigned char* p, const unsigned char* end, char* out, size_t out_size) {
+    if (end - p < 4) return 0;
+    uint32_t cch = read_u32(p);
+    if (cch == 0xFFFFFFFF) {  // XLNullableWideString null
+        out[0] = '\0';
+        return 4;
+    }
+    if ((size_t)(end - p - 4) / 2 < cch) return 0;
+
+    const unsigned char* s = p + 4;
+    size_t j = 0;
+    for (uint32_t i = 0; i < cch; i++) {
+        uint32_t c = s[2 * i] | (s[2 * i + 1] << 8);
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < cch) {
+            uint32_t low = s[2 * i + 2] | (s[2 * i + 3] << 8);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+        if (j + 4 >= out_size) break;
+        if (c < 0x80) {
+            out[j++] = (char)c;
+        } else if (c < 0x800) {
+            out[j++] = (char)(0xC0 | (c >> 6));
+            out[j++] = (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out[j++] = (char)(0xE0 | (c >> 12));
+            out[j++] = (char)(0x80 | ((c >> 6) & 0x3F));
+            out[j++] = (char)(0x80 | (c & 0x3F));
+        } else {
+            out[j++] = (char)(0xF0 | (c >> 18));
+            out[j++] = (char)(0x80 | ((c >> 12) & 0x3F));
+            out[j++] = (char)(0x80 | ((c >> 6) & 0x3F));
+            out[j++] = (char)(0x80 | (c & 0x3F));
+        }
+    }
+    out[j] = '\0';
+    return 4 + (size_t)cch * 2;
+}
+
+static const char* error_text(uint8_t code) {
+    switch (code) {
+        case 0x00: return "#NULL!";
+        case 0x07: return "#DIV/0!";
+        case 0x0F: return "#VALUE!";
+        case 0x17: return "#REF!";
+        case 0x1D: return "#NAME?";
+        case 0x24: return "#NUM!";
+        case 0x2A: return "#N/A";
+        case 0x2B: return "#GETTING_DATA";
+        default: return "#ERROR";
+    }
+}
+
+int xlsb_parse_workbook(const unsigned char* data, size_t size, XlsbSheetCallback on_sheet, void* user) {
+    XlsbReader reader = { data, data + size };
+    uint32_t type, len;
+    const unsigned char* body;
+    char name[XLSB_MAX_STRING];
+
+    while (next_record(&reader, &type, &body, &len)) {
+        if (type != BRT_BUNDLE_SH || len < 12) continue;
+
+        // hsState, iTabID, strRelID, strName
+        const unsigned char* end = body + len;
+        uint32_t sheet_id = read_u32(body + 4);
+        size_t used = read_wide_string(body + 8, end, name, sizeof(name));
+        if (!used) return 0;
+        if (!read_wide_string(body + 8 + used, end, name, sizeof(name))) return 0;
+        on_sheet(user, name, (int)sheet_id);
+    }
+    return reader.pos == reader.end;
+}
+
+int xlsb_parse_shared_strings(const unsigned char* data, size_t size, XlsbStringCallback on_string, void* user) {
+    XlsbReader reader = { data, data + size };
+    uint32_t type, len;
+    const unsigned char* body;
+    char* text = malloc(XLSB_MAX_STRING);
+    if (!text) return 0;
+
+    int ok = 1;
+    while (next_record(&reader, &type, &body, &len)) {
+        if (type != BRT_SST_ITEM) continue;
+
+        // RichStr: flags byte, then the plain text (formatting runs ignored)
+        if (len < 1 || !read_wide_string(body + 1, body + len, text, XLSB_MAX_STRING)) {
+            ok = 0;
+            break;
+        }
+        if (!on_string(user, text)) {
+            ok = 0;
+            break;
+        }
+    }
+
+    free(text);
+    return ok && reader.pos == reader.end;
+}
+
+int xlsb_parse_worksheet(const unsigned char* data, size_t size, char** strings, int string_count,
+                         XlsbCellCallback on_cell, void* user) {
+    XlsbReader reader = { data, data + size };
+    uint32_t type, len;
+    const unsigned char* body;
+    int row = -1;
+    char* text = malloc(XLSB_MAX_STRING);
+    if (!text) return 0;
+
+    while (next_record(&reader, &type, &body, &len)) {
+        if (type == BRT_ROW_HDR) {
+            if (len >= 4) row = (int)read_u32(body);
+            continue;
+        }
+        if (type > BRT_FMLA_ERROR || row < 0 || len < 8) continue;
+
+        // Cell: column, then style/flags; the value follows
+        int col = (int)read_u32(body);
+        const unsigned char* value = body + 8;
+        const unsigned char* end = body + len;
+        const char* cell_text = text;
+        int string_index = -1;
+        text[0] = '\0';
+
+        switch (type) {
+            case BRT_CELL_BLANK:
+                break;
+            case BRT_CELL_RK: {
+                if (end - value < 4) break;
+                uint32_t rk = read_u32(value);
+                double number;
+                if (rk & 2) {
+                    number = (double)((int32_t)rk >> 2);
+                } else {
+                    uint64_t bits = (uint64_t)(rk & 0xFFFFFFFC) << 32;
+                    memcpy(&number, &bits, sizeof(number));
+                }
+                if (rk & 1) number /= 100;
+                format_number(number, text);
+                break;
+            }
+            case BRT_CELL_REAL:
+            case BRT_FMLA_NUM: {
+                if (end - value < 8) break;
+                double number;
+                memcpy(&number, value, sizeof(number));
+                format_number(number, text);
+                break;
+            }
+            case BRT_CELL_BOOL:
+            case BRT_FMLA_BOOL:
+                if (end - value >= 1) cell_text = value[0] ? "1" : "0";
+                break;
+            case BRT_CELL_ERROR:
+            case BRT_FMLA_ERROR:
+                if (end - value >= 1) cell_text = error_text(value[0]);
+                break;
+            case BRT_CELL_ST:
+            case BRT_FMLA_STRING:
+                read_wide_string(value, end, text, XLSB_MAX_STRING);
+                break;
+            case BRT_CELL_ISST: {
+                if (end - value < 4) break;
+                uint32_t index = read_u32(value);
+                if (index < (uint32_t)string_count) {
+                    cell_text = strings[index];
+                    string_index = (int)index;
+                }
+                break;
+            }
+        }
+
+        if (!on_cell(user, row, col, cell_text, string_index)) break;
+    }
+
+    free(text);
+    return 1;
+}
+
+size_t xlsb_complete_rows_size(const unsigned char* data, size_t size) {
+    XlsbReader reader = { data, data + size };
+    uint32_t type, len;
+    const unsigned char* body;
+    const unsigned char* record = reader.pos;
+    const unsigned char* last_row = NULL;
+    size_t complete = 0;
+    while (next_record(&reader, &type, &body, &len)) {
+        if (type == BRT_ROW_HDR) {
+            if (last_row) complete = (size_t)(record - data);
+            last_row = record;
+        }
+        record = reader.pos;
+    }
+    return complete;
+}
+// *** XLSB END
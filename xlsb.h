@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+// *** XLSB
+// Reader for binary workbooks (.xlsb, BIFF12 records). Records are
+// length-prefixed, so no XML scanning or entity decoding is needed; strings
+// are UTF-16LE and are converted to UTF-8 before they reach the callbacks.
+
+typedef void (*XlsbSheetCallback)(void* user, const char* name, int sheet_id);
+// Return 0 to stop parsing
+typedef int (*XlsbStringCallback)(void* user, const char* utf8);
+// value is the cell text (numbers formatted like the <v> of an xlsx cell);
+// string_index is its shared-string index, -1 for other cells.
+// Return 0 to stop parsing
+typedef int (*XlsbCellCallback)(void* user, int row, int col, const char* value, int string_index);
+
+// xl/workbook.bin: reports each sheet in document order
+int xlsb_parse_workbook(const unsigned char* data, size_t size, XlsbSheetCallback on_sheet, void* user);
+// xl/sharedStrings.bin: reports each string in index order
+int xlsb_parse_shared_strings(const unsigned char* data, size_t size, XlsbStringCallback on_string, void* user);
+// xl/worksheets/sheetN.bin: shared-string cells are resolved through strings[]
+int xlsb_parse_worksheet(const unsigned char* data, size_t size, char** strings, int string_count,
+                         XlsbCellCallback on_cell, void* user);
+// Worksheet data cut short (see budget.h): bytes before its last row, whose
+// cells may be missing; 0 if no row before it is complete
+size_t xlsb_complete_rows_size(const unsigned char* data, size_t size);
+// *** XLSB END
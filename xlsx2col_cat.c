@@ -0,0 +1,489 @@
+// *** XLSX2COL-CAT
+// Reader for the .xcol files written by xlsx_to_tsv --format=col (layout in
+// colfile.h). Prints the sheet as TSV (byte for byte what the TSV output
+// would have been), only some of its columns, the file layout, or the sum
+// of one column. The file is mapped, so a projection or a sum only touches
+// the chunks of the columns it reads.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "colfile.h"
+#include "numfmt.h"
+
+#define CAT_BUFFER_SIZE (256 * 1024)
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    int column_count;
+    char** names;
+    uint32_t group_count;
+    uint64_t* group_offsets;
+    uint32_t* group_rows;
+    uint32_t string_count;
+    uint64_t* ends;             // dictionary: string i is text[ends[i - 1] .. ends[i])
+    const char* text;
+} ColFile;
+
+typedef struct {
+    uint8_t encoding;
+    uint64_t size;
+    const unsigned char* bitmap;    // cells that are not empty
+    uint32_t present;               // values (set bits)
+    const unsigned char* values;    // packed (INT64, DICT) or f64 (DOUBLE)
+    uint64_t base;
+    uint8_t width;
+    const unsigned char* exceptions;    // DOUBLE: (u32 row, u32 string id)
+    uint32_t exception_count;
+    uint32_t next;                  // scan position: next value
+    uint32_t next_exception;
+} ColChunk;
+
+typedef struct {
+    uint32_t rows;
+    const unsigned char* widths;    // u16 per row, NULL: every row has every column
+    ColChunk* chunks;
+} ColGroup;
+
+static void corrupt(const char* path) {
+    printf("Error: Not a valid .xcol file: %s\n", path);
+    exit(1);
+}
+
+static uint32_t read_u32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read_u64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Bounds-checked cursor over the mapped file
+typedef struct {
+    const ColFile* file;
+    const char* path;
+    size_t pos;
+} Cursor;
+
+static const unsigned char* take(Cursor* c, uint64_t len) {
+    if (len > c->file->size || c->pos > c->file->size - len) corrupt(c->path);
+    const unsigned char* p = c->file->data + c->pos;
+    c->pos += len;
+    return p;
+}
+
+static void* cat_alloc(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        printf("Error: Memory allocation failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void col_file_open(ColFile* file, const char* path) {
+    memset(file, 0, sizeof(*file));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Error: Could not open %s\n", path);
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 20) corrupt(path);
+    file->size = (size_t)st.st_size;
+    file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file->data == MAP_FAILED) corrupt(path);
+
+    if (memcmp(file->data, COLFILE_MAGIC, 4) != 0 || read_u32(file->data + 4) != COLFILE_VERSION ||
+        memcmp(file->data + file->size - 4, COLFILE_MAGIC, 4) != 0) {
+        corrupt(path);
+    }
+
+    Cursor c = { file, path, (size_t)read_u64(file->data + file->size - 12) };
+    file->column_count = (int)read_u32(take(&c, 4));
+    if (file->column_count > 1000000) corrupt(path);
+    file->names = cat_alloc(sizeof(char*) * file->column_count);
+    for (int i = 0; i < file->column_count; i++) {
+        uint32_t len = read_u32(take(&c, 4));
+        file->names[i] = cat_alloc(len + 1);
+        memcpy(file->names[i], take(&c, len), len);
+        file->names[i][len] = '\0';
+    }
+
+    file->group_count = read_u32(take(&c, 4));
+    file->group_offsets = cat_alloc(sizeof(uint64_t) * file->group_count);
+    file->group_rows = cat_alloc(sizeof(uint32_t) * file->group_count);
+    for (uint32_t i = 0; i < file->group_count; i++) {
+        file->group_offsets[i] = read_u64(take(&c, 8));
+        file->group_rows[i] = read_u32(take(&c, 4));
+    }
+
+    file->string_count = read_u32(take(&c, 4));
+    uint64_t text_len = read_u64(take(&c, 8));
+    if (file->string_count > file->size) corrupt(path);
+    file->ends = cat_alloc(sizeof(uint64_t) * file->string_count);
+    uint64_t end = 0;
+    for (uint32_t i = 0; i < file->string_count; i++) {
+        uint64_t len = 0;
+        for (int shift = 0;; shift += 7) {
+            unsigned char byte = *take(&c, 1);
+            if (shift > 56) corrupt(path);
+            len |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        end += len;
+        if (end > text_len) corrupt(path);
+        file->ends[i] = end;
+    }
+    file->text = (const char*)take(&c, text_len);
+}
+
+static void col_file_close(ColFile* file) {
+    for (int i = 0; i < file->column_count; i++) {
+        free(file->names[i]);
+    }
+    free(file->names);
+    free(file->group_offsets);
+    free(file->group_rows);
+    free(file->ends);
+    munmap((void*)file->data, file->size);
+}
+
+// Locate row group g and its chunks (nothing is decoded here)
+static void col_file_group(const ColFile* file, const char* path, uint32_t g, ColGroup* group) {
+    Cursor c = { file, path, (size_t)file->group_offsets[g] };
+    group->rows = read_u32(take(&c, 4));
+    if (group->rows != file->group_rows[g]) corrupt(path);
+    group->widths = *take(&c, 1) ? take(&c, (uint64_t)group->rows * 2) : NULL;
+
+    size_t bitmap_len = ((size_t)group->rows + 7) / 8;
+    for (int i = 0; i < file->column_count; i++) {
+        ColChunk* chunk = &group->chunks[i];
+        memset(chunk, 0, sizeof(*chunk));
+        chunk->encoding = *take(&c, 1);
+        chunk->size = read_u64(take(&c, 8));
+        size_t start = c.pos;
+        take(&c, chunk->size);
+        if (chunk->encoding == COLFILE_NULL) continue;
+        if (chunk->encoding > COLFILE_DICT) corrupt(path);
+
+        // Payload: bitmap, then the values of the set bits
+        Cursor p = { file, path, start };
+        chunk->bitmap = take(&p, bitmap_len);
+        for (size_t b = 0; b < bitmap_len; b++) {
+            chunk->present += (uint32_t)__builtin_popcount(chunk->bitmap[b]);
+        }
+        if (chunk->encoding == COLFILE_DOUBLE) {
+            chunk->values = take(&p, (uint64_t)chunk->present * 8);
+            chunk->exception_count = read_u32(take(&p, 4));
+            chunk->exceptions = take(&p, (uint64_t)chunk->exception_count * 8);
+        } else {
+            chunk->base = read_u64(take(&p, 8));
+            chunk->width = *take(&p, 1);
+            if (chunk->width < 1 || chunk->width > 8) corrupt(path);
+            chunk->values = take(&p, (uint64_t)chunk->present * chunk->width);
+        }
+        if (p.pos != c.pos) corrupt(path);
+    }
+}
+
+static inline bool chunk_present(const ColChunk* chunk, uint32_t row) {
+    return chunk->encoding != COLFILE_NULL && ((chunk->bitmap[row / 8] >> (row % 8)) & 1);
+}
+
+// Value k of an INT64 or DICT chunk
+static inline uint64_t chunk_packed(const ColChunk* chunk, uint32_t k) {
+    const unsigned char* p = chunk->values + (size_t)k * chunk->width;
+    uint64_t v = 0;
+    switch (chunk->width) {
+    case 1: v = p[0]; break;
+    case 2: { uint16_t x; memcpy(&x, p, 2); v = x; break; }
+    case 4: { uint32_t x; memcpy(&x, p, 4); v = x; break; }
+    default: memcpy(&v, p, chunk->width); break;
+    }
+    return chunk->base + v;
+}
+
+static inline int64_t chunk_int(const ColChunk* chunk, uint32_t k) {
+    return (int64_t)(chunk_packed(chunk, k) ^ (1ULL << 63));
+}
+
+static inline double chunk_double(const ColChunk* chunk, uint32_t k) {
+    double d;
+    memcpy(&d, chunk->values + (size_t)k * 8, sizeof(d));
+    return d;
+}
+
+static const char* dict_text(const ColFile* file, uint32_t id, size_t* len) {
+    if (id >= file->string_count) {
+        *len = 0;
+        return "";
+    }
+    uint64_t start = id > 0 ? file->ends[id - 1] : 0;
+    *len = (size_t)(file->ends[id] - start);
+    return file->text + start;
+}
+
+// *** output
+
+typedef struct {
+    char buf[CAT_BUFFER_SIZE];
+    size_t len;
+} Output;
+
+static void out_flush(Output* out) {
+    if (out->len > 0 && fwrite(out->buf, 1, out->len, stdout) != out->len) {
+        fprintf(stderr, "Error: write failed\n");
+        exit(1);
+    }
+    out->len = 0;
+}
+
+static void out_write(Output* out, const char* data, size_t len) {
+    if (out->len + len > sizeof(out->buf)) {
+        out_flush(out);
+        if (len > sizeof(out->buf)) {
+            fwrite(data, 1, len, stdout);
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
+
+static inline void out_putc(Output* out, char c) {
+    if (out->len == sizeof(out->buf)) out_flush(out);
+    out->buf[out->len++] = c;
+}
+
+// Cell text as in the TSV; cells of a chunk are visited in row order
+static void out_cell(Output* out, const ColFile* file, ColChunk* chunk, uint32_t row) {
+    if (!chunk_present(chunk, row)) return;
+    uint32_t k = chunk->next++;
+    char text[32];
+    size_t len;
+    switch (chunk->encoding) {
+    case COLFILE_INT64:
+        len = (size_t)snprintf(text, sizeof(text), "%lld", (long long)chunk_int(chunk, k));
+        out_write(out, text, len);
+        break;
+    case COLFILE_DOUBLE:
+        if (chunk->next_exception < chunk->exception_count &&
+            read_u32(chunk->exceptions + (size_t)chunk->next_exception * 8) == row) {
+            uint32_t id = read_u32(chunk->exceptions + (size_t)chunk->next_exception * 8 + 4);
+            const char* s = dict_text(file, id, &len);
+            out_write(out, s, len);
+            chunk->next_exception++;
+            break;
+        }
+        format_number(chunk_double(chunk, k), text);
+        out_write(out, text, strlen(text));
+        break;
+    case COLFILE_DICT: {
+        const char* s = dict_text(file, (uint32_t)chunk_packed(chunk, k), &len);
+        out_write(out, s, len);
+        break;
+    }
+    }
+}
+
+// All columns (projection NULL): each row as its TSV line, with only the
+// fields it had. Projected: the chosen columns of every row.
+static void cat_rows(const ColFile* file, const char* path, const int* projection, int projected) {
+    static Output out;
+    if (file->column_count == 0 && file->group_count == 0) return;  // sheet without rows
+    int fields = projection ? projected : file->column_count;
+    for (int i = 0; i < fields; i++) {
+        if (i > 0) out_putc(&out, '\t');
+        const char* name = file->names[projection ? projection[i] : i];
+        out_write(&out, name, strlen(name));
+    }
+    out_putc(&out, '\n');
+
+    ColGroup group;
+    group.chunks = cat_alloc(sizeof(ColChunk) * file->column_count);
+    // Projected fields scan copies of their chunks, so a column named
+    // twice (--columns=Qty,Qty) keeps one scan position per field
+    ColChunk* cursors = projection ? cat_alloc(sizeof(ColChunk) * fields) : group.chunks;
+    for (uint32_t g = 0; g < file->group_count; g++) {
+        col_file_group(file, path, g, &group);
+        for (int i = 0; projection && i < fields; i++) {
+            cursors[i] = group.chunks[projection[i]];
+        }
+        for (uint32_t row = 0; row < group.rows; row++) {
+            int width = fields;
+            if (!projection && group.widths) {
+                uint16_t w;
+                memcpy(&w, group.widths + (size_t)row * 2, sizeof(w));
+                width = w;
+            }
+            for (int i = 0; i < width; i++) {
+                if (i > 0) out_putc(&out, '\t');
+                out_cell(&out, file, &cursors[i], row);
+            }
+            out_putc(&out, '\n');
+        }
+    }
+    if (cursors != group.chunks) free(cursors);
+    free(group.chunks);
+    out_flush(&out);
+}
+
+// Sum of the numeric cells of one column, in row order (like awk's s += $K)
+static void sum_column(const ColFile* file, const char* path, int column) {
+    double sum = 0;
+    long long count = 0;
+    ColGroup group;
+    group.chunks = cat_alloc(sizeof(ColChunk) * file->column_count);
+    for (uint32_t g = 0; g < file->group_count; g++) {
+        col_file_group(file, path, g, &group);
+        const ColChunk* chunk = &group.chunks[column];
+        // Only the values are read; the bitmap is not needed for a sum
+        for (uint32_t k = 0; k < chunk->present; k++) {
+            if (chunk->encoding == COLFILE_INT64) {
+                sum += (double)chunk_int(chunk, k);
+            } else if (chunk->encoding == COLFILE_DOUBLE) {
+                sum += chunk_double(chunk, k);
+            } else {
+                // Text cells count when they read as a number
+                size_t len;
+                const char* s = dict_text(file, (uint32_t)chunk_packed(chunk, k), &len);
+                char buf[64];
+                if (len == 0 || len >= sizeof(buf) || strspn(s, "0123456789+-.eE") < len) continue;
+                memcpy(buf, s, len);
+                buf[len] = '\0';
+                char* end;
+                double d = strtod(buf, &end);
+                if (*end != '\0') continue;
+                sum += d;
+            }
+            count++;
+        }
+    }
+    free(group.chunks);
+    printf("%s\tsum=%.15g\tcount=%lld\n", file->names[column], sum, count);
+}
+
+static void print_info(const ColFile* file, const char* path) {
+    static const char* encodings[] = { "null", "int64", "double", "dict" };
+    long long rows = 0;
+    for (uint32_t g = 0; g < file->group_count; g++) rows += file->group_rows[g];
+    printf("file\t%s\nbytes\t%zu\nrows\t%lld\nrow_groups\t%u\ncolumns\t%d\n", path, file->size, rows,
+           file->group_count, file->column_count);
+    printf("dictionary\t%u strings\t%llu bytes\n", file->string_count,
+           (unsigned long long)(file->string_count ? file->ends[file->string_count - 1] : 0));
+
+    long long (*chunks)[4] = calloc(file->column_count ? file->column_count : 1, sizeof(*chunks));
+    uint64_t* bytes = calloc(file->column_count ? file->column_count : 1, sizeof(uint64_t));
+    ColGroup group;
+    group.chunks = cat_alloc(sizeof(ColChunk) * file->column_count);
+    if (!chunks || !bytes) {
+        printf("Error: Memory allocation failed\n");
+        exit(1);
+    }
+    for (uint32_t g = 0; g < file->group_count; g++) {
+        col_file_group(file, path, g, &group);
+        for (int i = 0; i < file->column_count; i++) {
+            chunks[i][group.chunks[i].encoding]++;
+            bytes[i] += group.chunks[i].size;
+        }
+    }
+
+    printf("column\tbytes\tchunks\n");
+    for (int i = 0; i < file->column_count; i++) {
+        printf("%s\t%llu\t", file->names[i], (unsigned long long)bytes[i]);
+        const char* sep = "";
+        for (int e = 0; e < 4; e++) {
+            if (!chunks[i][e]) continue;
+            printf("%s%s=%lld", sep, encodings[e], chunks[i][e]);
+            sep = ",";
+        }
+        printf("\n");
+    }
+    free(group.chunks);
+    free(chunks);
+    free(bytes);
+}
+
+static int find_column(const ColFile* file, const char* name, size_t len) {
+    for (int i = 0; i < file->column_count; i++) {
+        if (strlen(file->names[i]) == len && memcmp(file->names[i], name, len) == 0) return i;
+    }
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = NULL;
+    const char* columns = NULL;
+    const char* sum = NULL;
+    bool info = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--columns=", 10) == 0) {
+            columns = argv[i] + 10;
+        } else if (strncmp(argv[i], "--sum=", 6) == 0) {
+            sum = argv[i] + 6;
+        } else if (strcmp(argv[i], "--info") == 0) {
+            info = true;
+        } else if (strncmp(argv[i], "--", 2) != 0 && !path) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path) {
+        printf("Usage: %s <Sheet.xcol> [--columns=COL[,COL]] [--sum=COL] [--info]\n", argv[0]);
+        printf("  Prints the sheet as TSV (the same bytes as xlsx_to_tsv without --format=col)\n");
+        printf("  --columns=COL[,COL]: only these header columns, in this order\n");
+        printf("  --sum=COL: sum and count of the numeric cells of one column\n");
+        printf("  --info: row groups, dictionary size and per-column encodings\n");
+        return 1;
+    }
+
+    ColFile file;
+    col_file_open(&file, path);
+    int result = 0;
+    if (info) {
+        print_info(&file, path);
+    } else if (sum) {
+        int column = find_column(&file, sum, strlen(sum));
+        if (column < 0) {
+            printf("Error: Column not found: %s\n", sum);
+            result = 1;
+        } else {
+            sum_column(&file, path, column);
+        }
+    } else if (columns) {
+        int* projection = cat_alloc(sizeof(int) * (strlen(columns) + 1));
+        int projected = 0;
+        for (const char* name = columns; result == 0;) {
+            size_t len = strcspn(name, ",");
+            projection[projected] = find_column(&file, name, len);
+            if (projection[projected++] < 0) {
+                printf("Error: Column not found: %.*s\n", (int)len, name);
+                result = 1;
+            }
+            if (!name[len]) break;
+            name += len + 1;
+        }
+        if (result == 0) cat_rows(&file, path, projection, projected);
+        free(projection);
+    } else {
+        cat_rows(&file, path, NULL, 0);
+    }
+    col_file_close(&file);
+    return result;
+}
+// *** XLSX2COL-CAT END
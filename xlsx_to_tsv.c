@@ -5,9 +5,19 @@
 #include <time.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "miniz.h"
 #include "filter.h"
+#include "uring_io.h"
+#include "serve.h"
+#include "rowindex.h"
+#include "rowhash.h"
+#include "xlsb.h"
+#include "budget.h"
+#include "fatal.h"
 
 // *** xlsx_to_tsv
 
@@ -15,6 +25,9 @@
 #define BUFFER_SIZE 65536
 #define MAX_SHEET_NAME 256
 #define MAX_SHEETS 50
+#define SHARED_STRINGS_PARALLEL_MIN (1 << 20)  // smaller tables are parsed serially
+#define SHARED_STRINGS_POLL 1024               // strings between --deadline checks
+#define EXIT_TRUNCATED 2                       // a --deadline / --max-cells limit stopped the conversion
 
 // Shared strings structure for performance
 typedef struct {
@@ -142,12 +155,16 @@ void add_shared_string(SharedStrings* ss, const char* str) {
 #endif
 }
 
-// Parse shared strings XML by extracting text content and skipping all tags
-void parse_shared_strings(const char* xml_data, SharedStrings* ss) {
+// Parse shared strings XML by extracting text content and skipping all tags.
+// Only items starting before limit are parsed (NULL = whole buffer), and
+// parsing stops early once the conversion's budget runs out.
+void parse_shared_strings_range(const char* xml_data, const char* limit, SharedStrings* ss) {
     const char* pos = xml_data;
     
     // Find each <si> (shared string item) element
-    while ((pos = strstr(pos, "<si")) != NULL) {
+    while ((pos = strstr(pos, "<si")) != NULL && (!limit || pos < limit)) {
+        if (ss->count % SHARED_STRINGS_POLL == 0 && budget_poll()) break;
+
         // Check for self-closing tag <si/>
         const char* tag_end = strchr(pos, '>');
         if (!tag_end) break;
@@ -197,6 +214,116 @@ void parse_shared_strings(const char* xml_data, SharedStrings* ss) {
     }
 }
 
+void parse_shared_strings(const char* xml_data, SharedStrings* ss) {
+    parse_shared_strings_range(xml_data, NULL, ss);
+}
+
+// Find the first <si> or <si/> item at or after pos (the places where the
+// serial parser starts an item), or end if there is none
+const char* next_shared_string_item(const char* pos, const char* end) {
+    while ((pos = strstr(pos, "<si")) != NULL && pos < end) {
+        const char* tag_end = strchr(pos, '>');
+        if (!tag_end) break;
+        if (*(tag_end - 1) == '/' || *(pos + 3) == '>') return pos;
+        pos++;
+    }
+    return end;
+}
+
+typedef struct {
+    const char* start;
+    const char* limit;
+    SharedStrings strings;
+    Budget budget;          // the caller's, in and out (BUDGET is per thread)
+} SharedStringsChunk;
+
+void* parse_shared_strings_chunk(void* arg) {
+    SharedStringsChunk* chunk = arg;
+    BUDGET = chunk->budget;
+    parse_shared_strings_range(chunk->start, chunk->limit, &chunk->strings);
+    chunk->budget = BUDGET;
+    return NULL;
+}
+
+// Parallel load: split the buffer on <si> boundaries, decode each range on
+// its own thread, then place each chunk at the prefix sum of earlier counts.
+// Produces the same table as parse_shared_strings().
+void parse_shared_strings_parallel(const char* xml_data, size_t size, SharedStrings* ss, int threads) {
+    if (threads <= 1 || size < SHARED_STRINGS_PARALLEL_MIN) {
+        parse_shared_strings(xml_data, ss);
+        return;
+    }
+    
+    const char* end = xml_data + size;
+    SharedStringsChunk* chunks = calloc(threads, sizeof(SharedStringsChunk));
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    
+    const char* start = next_shared_string_item(xml_data, end);
+    for (int i = 0; i < threads; i++) {
+        const char* limit = (i == threads - 1) ? end
+            : next_shared_string_item(xml_data + size / threads * (i + 1), end);
+        if (limit < start) limit = start;
+        chunks[i].start = start;
+        chunks[i].limit = limit;
+        start = limit;
+    }
+    
+    for (int i = 0; i < threads; i++) {
+        chunks[i].strings.capacity = 1024;
+        chunks[i].strings.strings = malloc(sizeof(char*) * chunks[i].strings.capacity);
+        chunks[i].strings.count = 0;
+        chunks[i].budget = BUDGET;
+        pthread_create(&tids[i], NULL, parse_shared_strings_chunk, &chunks[i]);
+    }
+    
+    int total = ss->count;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        total += chunks[i].strings.count;
+        if (chunks[i].budget.stop != BUDGET_OK && BUDGET.stop == BUDGET_OK) {
+            BUDGET.stop = chunks[i].budget.stop;
+            budget_check();
+        }
+    }
+    
+    if (total > ss->capacity) {
+        ss->capacity = total;
+        ss->strings = realloc(ss->strings, sizeof(char*) * ss->capacity);
+    }
+    for (int i = 0; i < threads; i++) {
+        memcpy(ss->strings + ss->count, chunks[i].strings.strings, sizeof(char*) * chunks[i].strings.count);
+        ss->count += chunks[i].strings.count;
+        free(chunks[i].strings.strings);
+    }
+    
+    free(tids);
+    free(chunks);
+}
+
+// Store one sheet of the workbook, skipping names with invalid characters.
+// ext is the worksheet part extension ("xml" or "bin").
+void add_workbook_sheet(Workbook* wb, const char* name, int sheet_id, const char* ext) {
+    if (wb->sheet_count >= MAX_SHEETS) return;
+    
+    // Skip sheets with invalid characters (only allow A-Z, a-z, 0-9, -, _, *)
+    if (!is_valid_name(name)) {
+        printf("Skipping sheet: '%s' (contains invalid characters - only A-Z, a-z, 0-9, -, _, * allowed)\n", name);
+        return;
+    }
+    
+    // Store sheet information
+    strncpy(wb->sheets[wb->sheet_count].name, name, MAX_SHEET_NAME - 1);
+    wb->sheets[wb->sheet_count].name[MAX_SHEET_NAME - 1] = '\0';
+    wb->sheets[wb->sheet_count].sheet_id = sheet_id;
+    
+    // Generate worksheet filename using sequential order (not sheetId)
+    // Excel file structure uses sheet1.xml, sheet2.xml, etc. in document order
+    snprintf(wb->sheets[wb->sheet_count].filename, MAX_SHEET_NAME,
+            "xl/worksheets/sheet%d.%s", wb->sheet_count + 1, ext);
+
+    wb->sheet_count++;
+}
+
 // Parse workbook.xml to get sheet information
 void parse_workbook(const char* xml_data, Workbook* wb) {
     wb->sheet_count = 0;
@@ -214,26 +341,7 @@ void parse_workbook(const char* xml_data, Workbook* wb) {
         char* sheet_id_attr = find_attribute(pos, "sheetId=");
         int sheet_id = sheet_id_attr ? atoi(sheet_id_attr) : wb->sheet_count + 1;
         
-        // Skip sheets with invalid characters (only allow A-Z, a-z, 0-9, -, _, *)
-        if (!is_valid_name(name_attr)) {
-            printf("Skipping sheet: '%s' (contains invalid characters - only A-Z, a-z, 0-9, -, _, * allowed)\n", name_attr);
-            free(name_attr);
-            if (sheet_id_attr) free(sheet_id_attr);
-            pos++;
-            continue;
-        }
-        
-        // Store sheet information
-        strncpy(wb->sheets[wb->sheet_count].name, name_attr, MAX_SHEET_NAME - 1);
-        wb->sheets[wb->sheet_count].name[MAX_SHEET_NAME - 1] = '\0';
-        wb->sheets[wb->sheet_count].sheet_id = sheet_id;
-        
-        // Generate worksheet filename using sequential order (not sheetId)
-        // Excel file structure uses sheet1.xml, sheet2.xml, etc. in document order
-        snprintf(wb->sheets[wb->sheet_count].filename, MAX_SHEET_NAME,
-                "xl/worksheets/sheet%d.xml", wb->sheet_count + 1);
-
-        wb->sheet_count++;
+        add_workbook_sheet(wb, name_attr, sheet_id, "xml");
         
         free(name_attr);
         if (sheet_id_attr) free(sheet_id_attr);
@@ -295,11 +403,308 @@ void create_safe_filename(const char* sheet_name, char* safe_name, int max_len)
     strcpy(safe_name + j, ".tsv");
 }
 
+// *** row predicates (--where)
+// A data row is kept only if every --where clause holds. Clauses name a
+// header column; the header row always passes and fixes each clause's sheet
+// column. String literals are looked up in the shared strings once per
+// workbook, so a shared-string cell is tested with one bit lookup instead of
+// a string compare. A row's cells are held back only until every clause
+// column has been seen, and rejected rows never reach the Filter.
+
+#define MAX_WHERE 8
+
+typedef enum { WHERE_EQ, WHERE_NE, WHERE_LT, WHERE_GT } WhereOp;
+
+typedef struct {
+    char column[MAX_SHEET_NAME];
+    WhereOp op;
+    char* values;               // = / != literals, NUL-separated
+    int value_count;
+    double number;              // < / > operand
+    unsigned char* ss_match;    // bit per shared string equal to a literal
+    int ss_count;
+    int col;                    // sheet column (0-based), -1 = not in header
+    bool decided;               // already checked in the current row
+} WhereClause;
+
+typedef struct {
+    WhereClause clauses[MAX_WHERE];
+    int count;
+    bool compiled;              // ss_match built for the current workbook
+    bool header_row;            // current row is the sheet's header row
+    int columns_found;          // clauses whose column is in the header
+    bool missing_rejects;       // a clause on a missing (empty) column fails
+    int pending;                // clauses not yet decided in the current row
+    bool rejected;
+    // Cells pushed while pending > 0: shared-string index, then the
+    // NUL-terminated value, back to back
+    char* held;
+    size_t held_len;
+    size_t held_capacity;
+    int held_count;
+    FILE* log;                  // conversion log for warnings, NULL = quiet
+} RowGate;
+
+// COL=V1,V2 / COL!=V1,V2 / COL<N / COL>N; operand points into expr
+int where_split(const char* expr, char* column, size_t column_size, WhereOp* op, const char** operand) {
+    size_t len = strcspn(expr, "!=<>");
+    if (len == 0 || len >= column_size || !expr[len]) return 0;
+    memcpy(column, expr, len);
+    column[len] = '\0';
+
+    const char* p = expr + len;
+    if (p[0] == '!' && p[1] == '=') {
+        *op = WHERE_NE;
+        p += 2;
+    } else if (*p == '=') {
+        *op = WHERE_EQ;
+        p++;
+    } else if (*p == '<') {
+        *op = WHERE_LT;
+        p++;
+    } else if (*p == '>') {
+        *op = WHERE_GT;
+        p++;
+    } else {
+        return 0;
+    }
+    *operand = p;
+
+    if (*op == WHERE_LT || *op == WHERE_GT) {
+        char* end;
+        strtod(p, &end);
+        if (end == p || *end) return 0;
+    }
+    return 1;
+}
+
+void row_gate_free(RowGate* gate) {
+    for (int i = 0; i < gate->count; i++) {
+        free(gate->clauses[i].values);
+        free(gate->clauses[i].ss_match);
+    }
+    free(gate->held);
+    memset(gate, 0, sizeof(*gate));
+}
+
+// Parse the clauses of one conversion (already checked by parse_convert_option)
+void row_gate_setup(RowGate* gate, const char* const* exprs, int count, FILE* log) {
+    row_gate_free(gate);
+    gate->log = log;
+    for (int i = 0; i < count && gate->count < MAX_WHERE; i++) {
+        WhereClause* clause = &gate->clauses[gate->count];
+        const char* operand;
+        if (!where_split(exprs[i], clause->column, sizeof(clause->column), &clause->op, &operand)) continue;
+
+        if (clause->op == WHERE_LT || clause->op == WHERE_GT) {
+            clause->number = strtod(operand, NULL);
+        } else {
+            clause->values = strdup(operand);
+            if (!clause->values) {
+                fatal_error("Memory allocation failed");
+            }
+            clause->value_count = 1;
+            for (char* c = clause->values; *c; c++) {
+                if (*c == ',') {
+                    *c = '\0';
+                    clause->value_count++;
+                }
+            }
+        }
+        gate->count++;
+    }
+}
+
+bool where_literal_match(const WhereClause* clause, const char* text) {
+    const char* value = clause->values;
+    for (int i = 0; i < clause->value_count; i++) {
+        if (strcmp(value, text) == 0) return true;
+        value += strlen(value) + 1;
+    }
+    return false;
+}
+
+// ss_index >= 0 for a shared-string cell, whose text is then ss->strings[ss_index]
+bool where_match(const WhereClause* clause, int ss_index, const char* text) {
+    if (clause->op == WHERE_EQ || clause->op == WHERE_NE) {
+        bool equal = ss_index >= 0 && ss_index < clause->ss_count
+                         ? (clause->ss_match[ss_index >> 3] >> (ss_index & 7)) & 1
+                         : where_literal_match(clause, text);
+        return clause->op == WHERE_EQ ? equal : !equal;
+    }
+
+    char* end;
+    double value = strtod(text, &end);
+    if (end == text || *end) return false;  // not a number
+    return clause->op == WHERE_LT ? value < clause->number : value > clause->number;
+}
+
+// Header names match with wildcards removed, like the TSV header
+bool where_column_match(const char* column, const char* header) {
+    for (; *header; header++) {
+        if (*header == '*') continue;
+        if (*header != *column) return false;
+        column++;
+    }
+    return *column == '\0';
+}
+
+// Called before each sheet; literals are resolved against ss on first use
+void row_gate_begin_sheet(RowGate* gate, const SharedStrings* ss) {
+    if (!gate) return;
+    if (!gate->compiled) {
+        for (int i = 0; i < gate->count; i++) {
+            WhereClause* clause = &gate->clauses[i];
+            if (clause->op != WHERE_EQ && clause->op != WHERE_NE) continue;
+            clause->ss_match = calloc((size_t)ss->count / 8 + 1, 1);
+            if (!clause->ss_match) {
+                fatal_error("Memory allocation failed");
+            }
+            clause->ss_count = ss->count;
+            for (int s = 0; s < ss->count; s++) {
+                if (where_literal_match(clause, ss->strings[s])) {
+                    clause->ss_match[s >> 3] |= (unsigned char)(1 << (s & 7));
+                }
+            }
+        }
+        gate->compiled = true;
+    }
+    for (int i = 0; i < gate->count; i++) {
+        gate->clauses[i].col = -1;
+    }
+    gate->columns_found = 0;
+    gate->missing_rejects = false;
+}
+
+void row_gate_begin_row(RowGate* gate, const Filter* output) {
+    if (!gate) return;
+    gate->header_row = output->row_count == 0;
+    gate->pending = gate->header_row ? 0 : gate->columns_found;
+    gate->rejected = !gate->header_row && gate->missing_rejects;
+    gate->held_len = 0;
+    gate->held_count = 0;
+    for (int i = 0; i < gate->count; i++) {
+        gate->clauses[i].decided = false;
+    }
+}
+
+static void row_gate_release(RowGate* gate, Filter* output) {
+    const char* value = gate->held;
+    for (int i = 0; i < gate->held_count; i++) {
+        int string_index;
+        memcpy(&string_index, value, sizeof(string_index));
+        value += sizeof(string_index);
+        filter_push_string(output, value, string_index);
+        value += strlen(value) + 1;
+    }
+    gate->held_count = 0;
+    gate->held_len = 0;
+}
+
+// string_index as for filter_push_string
+static inline void row_gate_push(RowGate* gate, Filter* output, const char* value, int string_index) {
+    if (!gate || (gate->pending == 0 && !gate->rejected)) {
+        filter_push_string(output, value, string_index);
+        return;
+    }
+    if (gate->rejected) return;
+
+    size_t len = strlen(value) + 1;
+    if (gate->held_len + sizeof(string_index) + len > gate->held_capacity) {
+        size_t capacity = gate->held_capacity ? gate->held_capacity * 2 : 4096;
+        while (capacity < gate->held_len + sizeof(string_index) + len) capacity *= 2;
+        char* grown = realloc(gate->held, capacity);
+        if (!grown) {
+            fatal_error("Memory allocation failed");
+        }
+        gate->held = grown;
+        gate->held_capacity = capacity;
+    }
+    memcpy(gate->held + gate->held_len, &string_index, sizeof(string_index));
+    gate->held_len += sizeof(string_index);
+    memcpy(gate->held + gate->held_len, value, len);
+    gate->held_len += len;
+    gate->held_count++;
+}
+
+// Check a cell against the clauses on its column; false once the row is
+// rejected (its remaining cells can be skipped)
+static inline bool row_gate_cell(RowGate* gate, Filter* output, int col, int ss_index, const char* text) {
+    if (!gate) return true;
+    if (gate->rejected) return false;
+
+    if (gate->header_row) {
+        for (int i = 0; i < gate->count; i++) {
+            WhereClause* clause = &gate->clauses[i];
+            if (clause->col < 0 && where_column_match(clause->column, text)) {
+                clause->col = col;
+                gate->columns_found++;
+            }
+        }
+        return true;
+    }
+
+    if (gate->pending == 0) return true;
+    for (int i = 0; i < gate->count; i++) {
+        WhereClause* clause = &gate->clauses[i];
+        if (clause->col != col || clause->decided) continue;
+        clause->decided = true;
+        gate->pending--;
+        if (!where_match(clause, ss_index, text)) {
+            gate->rejected = true;
+            return false;
+        }
+    }
+    if (gate->pending == 0) row_gate_release(gate, output);
+    return true;
+}
+
+// Replaces filter_finish_line at the end of each row
+void row_gate_end_row(RowGate* gate, Filter* output) {
+    if (!gate) {
+        filter_finish_line(output);
+        return;
+    }
+
+    if (gate->header_row) {
+        // Clauses on columns the header lacks see an empty cell in every row
+        for (int i = 0; i < gate->count; i++) {
+            WhereClause* clause = &gate->clauses[i];
+            if (clause->col >= 0) continue;
+            if (gate->log) {
+                fprintf(gate->log, "Warning: --where column not found: %s - treated as empty\n", clause->column);
+            }
+            if (!where_match(clause, -1, "")) gate->missing_rejects = true;
+        }
+        filter_finish_line(output);
+        return;
+    }
+
+    if (gate->rejected) return;
+    if (gate->pending > 0) {
+        // Clause columns without a cell in this row are empty
+        for (int i = 0; i < gate->count; i++) {
+            WhereClause* clause = &gate->clauses[i];
+            if (clause->col >= 0 && !clause->decided && !where_match(clause, -1, "")) return;
+        }
+        row_gate_release(gate, output);
+    }
+    filter_finish_line(output);
+}
+
+// *** row predicates (--where) END
+
 // High-performance worksheet parser
-void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, Filter* output) {
+// Rows after end_row end the scan (worksheet rows are stored in order)
+// gate: --where clauses, NULL to keep every row
+// When the budget runs out the scan stops before the next row and the
+// output is marked truncated.
+void parse_worksheet_rows(const char* xml_data, SharedStrings* ss, int start_row, int end_row,
+                          RowGate* gate, Filter* output) {
     const char* pos = xml_data;
     int last_row = -1;
     int last_col = -1;
+    int row_cells = 0;
     
     while ((pos = strstr(pos, "<c ")) != NULL) {
         // Find the end of this cell tag to limit our search scope
@@ -350,24 +755,37 @@ void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, Fil
             pos = cell_end;
             continue;
         }
+        if (row > end_row) {
+            free(cell_content);
+            free(r_attr);
+            break;
+        }
         
         // If we moved to a new row, output newline and reset column tracking
         if (last_row != -1 && row != last_row) {
-            filter_finish_line(output);
+            row_gate_end_row(gate, output);
 #ifdef DEBUG
             printf("DEBUG: New row, outputting newline\n");
 #endif
             last_col = -1;
+            if (budget_add_cells(row_cells)) {
+                output->truncated = true;
+                last_row = -1;  // already ended
+                free(cell_content);
+                free(r_attr);
+                break;
+            }
+            row_cells = 0;
         }
+        if (row != last_row) {
+            row_gate_begin_row(gate, output);
+        }
+        row_cells++;
         
         // Fill empty columns with tabs (for columns between last_col and current col)
         int tabs_needed = col - last_col - 1;
         if (last_col >= 0) tabs_needed++; // Add one more tab to separate from previous cell
         
-        for (int i = 0; i < tabs_needed; i++) {
-            filter_push(output, "");
-        }
-        
         // Extract cell type from the same cell content
         char* t_attr = NULL;
         char* temp_t_attr = find_attribute(cell_content, "t=");
@@ -425,6 +843,37 @@ void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, Fil
             }
         }
         
+        if (gate) {
+            // Shared strings are checked by index, other cells by their text
+            int ss_index = -1;
+            const char* text = v_content ? v_content : "";
+            if (v_content && t_attr && strcmp(t_attr, "s") == 0) {
+                ss_index = atoi(v_content);
+                if (ss_index >= 0 && ss_index < ss->count) {
+                    text = ss->strings[ss_index];
+                } else {
+                    ss_index = -1;
+                    text = "";
+                }
+            }
+            if (!row_gate_cell(gate, output, col, ss_index, text)) {
+                // Rejected row: skip its remaining cells
+                const char* row_close = strstr(cell_end, "</row>");
+                last_row = row;
+                free(cell_content);
+                free(r_attr);
+                if (t_attr) free(t_attr);
+                if (v_content) free(v_content);
+                pos = row_close ? row_close : cell_end;
+                continue;
+            }
+        }
+        
+        for (int i = 0; i < tabs_needed; i++) {
+            row_gate_push(gate, output, "", -1);
+        }
+        
+        int string_index = -1;
         if (v_content) {
             // Handle different cell types
             if (t_attr && strcmp(t_attr, "s") == 0) {
@@ -432,6 +881,7 @@ void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, Fil
                 int str_index = atoi(v_content);
                 if (str_index >= 0 && str_index < ss->count) {
                     escape_tsv_value(ss->strings[str_index], cell_value, MAX_CELL_VALUE);
+                    string_index = str_index;
 #ifdef DEBUG
                     printf("DEBUG: Cell %s [+%dtabs] '%s' : shared_string[%d] : '%s'\n", 
                            r_attr, tabs_needed, v_content, str_index, cell_value);
@@ -452,7 +902,7 @@ void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, Fil
         }
         
         // Output cell value
-        filter_push(output, cell_value);
+        row_gate_push(gate, output, cell_value, string_index);
         
         last_row = row;
         last_col = col;
@@ -468,10 +918,153 @@ void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, Fil
     
     // Output final newline if we processed any rows
     if (last_row >= start_row) {
-        filter_finish_line(output);
+        row_gate_end_row(gate, output);
+    }
+    BUDGET.cells += row_cells;  // checked before the next row or sheet
+}
+
+void parse_worksheet(const char* xml_data, SharedStrings* ss, int start_row, RowGate* gate, Filter* output) {
+    parse_worksheet_rows(xml_data, ss, start_row, INT_MAX, gate, output);
+}
+
+// Row (0-based) of the first cell at or after start_row, -1 if none. That
+// row is the header: parse_worksheet starts the output with it.
+int first_cell_row(const char* xml_data, int start_row) {
+    const char* pos = xml_data;
+    while ((pos = strstr(pos, "<c ")) != NULL) {
+        const char* tag_end = strchr(pos, '>');
+        if (!tag_end) break;
+        const char* r = strstr(pos, " r=\"");
+        if (r && r < tag_end) {
+            int row = extract_row_num(r + 4);
+            if (row >= start_row) return row;
+        }
+        pos = tag_end;
+    }
+    return -1;
+}
+
+// Row (0-based) of the first <row> tag at or after pos, -1 if none.
+// If limit is set, a tag that is not complete before it counts as none.
+int next_row_tag(const char* pos, const char* limit, const char** tag) {
+    while ((pos = strstr(pos, "<row")) != NULL) {
+        if (pos[4] != ' ' && pos[4] != '>') {
+            pos++;
+            continue;
+        }
+        const char* tag_end = strchr(pos, '>');
+        if (!tag_end || (limit && tag_end >= limit)) return -1;
+        
+        *tag = pos;
+        const char* r = strstr(pos, " r=\"");
+        if (r && r < tag_end) {
+            return atoi(r + 4) - 1;
+        }
+        pos = tag_end;
+    }
+    return -1;
+}
+
+// *** xlsb glue
+
+void xlsb_add_sheet(void* user, const char* name, int sheet_id) {
+    add_workbook_sheet((Workbook*)user, name, sheet_id, "bin");
+}
+
+// Binary strings are stored as-is (no XML entities to decode)
+int xlsb_add_shared_string(void* user, const char* str) {
+    SharedStrings* ss = user;
+    if (ss->count % SHARED_STRINGS_POLL == 0 && budget_poll()) return 0;
+    if (ss->count >= ss->capacity) {
+        ss->capacity *= 2;
+        ss->strings = realloc(ss->strings, sizeof(char*) * ss->capacity);
+    }
+    ss->strings[ss->count] = strdup(str);
+    ss->count++;
+    return 1;
+}
+
+typedef struct {
+    Filter* output;
+    RowGate* gate;
+    int start_row;
+    int end_row;
+    int last_row;
+    int last_col;
+    int row_cells;
+} XlsbSheetWriter;
+
+// Mirrors parse_worksheet's row/column padding so both formats give the same TSV
+int xlsb_write_cell(void* user, int row, int col, const char* value, int string_index) {
+    XlsbSheetWriter* writer = user;
+    if (row < writer->start_row) return 1;
+    if (row > writer->end_row) return 0;
+    
+    if (writer->last_row != -1 && row != writer->last_row) {
+        row_gate_end_row(writer->gate, writer->output);
+        writer->last_col = -1;
+        if (budget_add_cells(writer->row_cells)) {
+            writer->output->truncated = true;
+            writer->last_row = -1;  // already ended
+            return 0;
+        }
+        writer->row_cells = 0;
+    }
+    if (row != writer->last_row) {
+        row_gate_begin_row(writer->gate, writer->output);
+    }
+    writer->last_row = row;
+    writer->row_cells++;
+    if (!row_gate_cell(writer->gate, writer->output, col, string_index, value)) return 1;
+    
+    int tabs_needed = col - writer->last_col - 1;
+    if (writer->last_col >= 0) tabs_needed++;
+    for (int i = 0; i < tabs_needed; i++) {
+        row_gate_push(writer->gate, writer->output, "", -1);
+    }
+    
+    char cell_value[MAX_CELL_VALUE];
+    escape_tsv_value(value, cell_value, MAX_CELL_VALUE);
+    row_gate_push(writer->gate, writer->output, cell_value, string_index);
+    
+    writer->last_col = col;
+    return 1;
+}
+
+typedef struct {
+    int start_row;
+    int row;                // first cell row found, -1 = none yet
+} XlsbRowFinder;
+
+int xlsb_find_cell_row(void* user, int row, int col, const char* value, int string_index) {
+    (void)col;
+    (void)value;
+    (void)string_index;
+    XlsbRowFinder* finder = user;
+    if (row < finder->start_row) return 1;
+    finder->row = row;
+    return 0;
+}
+
+// first_cell_row for a binary worksheet
+int first_cell_row_bin(const char* data, size_t size, SharedStrings* ss, int start_row) {
+    XlsbRowFinder finder = { start_row, -1 };
+    xlsb_parse_worksheet((const unsigned char*)data, size, ss->strings, ss->count, xlsb_find_cell_row, &finder);
+    return finder.row;
+}
+
+void parse_worksheet_bin(const char* data, size_t size, SharedStrings* ss, int start_row, int end_row,
+                         RowGate* gate, Filter* output) {
+    XlsbSheetWriter writer = { output, gate, start_row, end_row, -1, -1, 0 };
+    xlsb_parse_worksheet((const unsigned char*)data, size, ss->strings, ss->count, xlsb_write_cell, &writer);
+    if (writer.last_row >= start_row) {
+        row_gate_end_row(gate, output);
     }
+    BUDGET.cells += writer.row_cells;
 }
 
+// *** xlsb glue END
+
 // Free shared strings memory
 void free_shared_strings(SharedStrings* ss) {
     for (int i = 0; i < ss->count; i++) {
@@ -482,165 +1075,1374 @@ void free_shared_strings(SharedStrings* ss) {
     ss->capacity = 0;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <input.xlsx> [start_row] [--no-wildcard]\n", argv[0]);
-        printf("  start_row: 1-based row number to start conversion (default: 1)\n");
-        printf("\n");
-        printf("Wildcard (*) character behavior:\n");
-        printf("  Default mode:\n");
-        printf("    - * characters are removed from sheet/column names in output\n");
-        printf("    - Example: '*Sales' -> 'Sales.tsv', '*ID' column -> 'ID'\n");
-        printf("  --no-wildcard mode:\n");
-        printf("    - Sheets containing * will be skipped entirely\n");
-        printf("    - Columns containing * will be excluded from output\n");
-        printf("\n");
-        printf("Note: Only A-Z, a-z, 0-9, -, _, * characters are valid in sheet/column names\n");
-        printf("      Names with spaces, special characters, or non-ASCII will be skipped\n");
-        return 1;
+// Drop all strings but keep the index array for the next workbook
+void clear_shared_strings(SharedStrings* ss) {
+    for (int i = 0; i < ss->count; i++) {
+        free(ss->strings[i]);
     }
-    
-    const char* input_file = argv[1];
-    int start_row = (argc > 2) ? atoi(argv[2]) - 1 : 0;  // Convert to 0-based
-    if (argc > 3 && strcmp(argv[3], "--no-wildcard") == 0) {
-        ALLOW_WILD_CARD = false;
+    ss->count = 0;
+}
+
+// Byte of the escaped TSV text (see escape_tsv_value); never 0
+static inline unsigned char tsv_byte(char c) {
+    return c == '\t' || c == '\n' || c == '\r' ? ' ' : (unsigned char)c;
+}
+
+typedef struct {
+    uint64_t key;           // next 8 TSV bytes, big-endian, zero past the end
+    const char* pos;        // where key was read
+    int index;
+} RankItem;
+
+static int compare_rank_items(const void* a, const void* b) {
+    uint64_t x = ((const RankItem*)a)->key;
+    uint64_t y = ((const RankItem*)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+#define RANK_RADIX_MIN 4096  // smaller groups are sorted with qsort
+
+// LSD radix sort of items by key, 16 bits per pass; passes where every key
+// shares the digit are skipped
+static void radix_sort_rank_items(RankItem* items, RankItem* tmp, size_t n) {
+    size_t* histogram = calloc(4 * 65536, sizeof(size_t));
+    if (!histogram) {
+        qsort(items, n, sizeof(RankItem), compare_rank_items);
+        return;
     }
-    if (start_row < 0) start_row = 0;
-    
-    printf("Converting XLSX to multiple TSV files...\n");
-    printf("Input: %s\n", input_file);
-    printf("Starting from row: %d\n", start_row + 1);
-    
-    clock_t start_time = clock();
-    
-    // Open XLSX file
-    mz_zip_archive zip;
-    if (!mz_zip_reader_init_file(&zip, input_file)) {
-        printf("Error: Could not open XLSX file: %s\n", input_file);
-        return 1;
+    for (size_t i = 0; i < n; i++) {
+        for (int pass = 0; pass < 4; pass++) {
+            histogram[pass * 65536 + ((items[i].key >> (pass * 16)) & 0xFFFF)]++;
+        }
     }
-    
-    // Initialize workbook and parse sheet information
-    Workbook workbook;
-    int workbook_index;
-    if (!mz_zip_reader_locate_file(&zip, "xl/workbook.xml", &workbook_index)) {
-        printf("Error: Could not find workbook.xml in XLSX file\n");
-        mz_zip_reader_end(&zip);
-        return 1;
+
+    RankItem* src = items;
+    RankItem* dst = tmp;
+    for (int pass = 0; pass < 4; pass++) {
+        size_t* counts = &histogram[pass * 65536];
+        if (counts[(src[0].key >> (pass * 16)) & 0xFFFF] == n) continue;
+
+        size_t offset = 0;
+        for (int d = 0; d < 65536; d++) {
+            size_t c = counts[d];
+            counts[d] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[counts[(src[i].key >> (pass * 16)) & 0xFFFF]++] = src[i];
+        }
+        RankItem* swap = src;
+        src = dst;
+        dst = swap;
     }
-    
-    size_t workbook_size = mz_zip_reader_get_file_size(&zip, workbook_index);
-    char* workbook_data = malloc(workbook_size + 1);
-    
-    if (!mz_zip_reader_extract_to_mem(&zip, workbook_index, workbook_data, workbook_size)) {
-        printf("Error: Could not extract workbook.xml\n");
-        free(workbook_data);
-        mz_zip_reader_end(&zip);
-        return 1;
+    if (src != items) memcpy(items, src, sizeof(RankItem) * n);
+    free(histogram);
+}
+
+// Sort items that agree up to pos by the next 8 bytes, then recurse into
+// each group that still agrees; ranks are handed out in order from rank
+static uint32_t rank_items(RankItem* items, RankItem* tmp, size_t n, uint32_t rank, uint32_t* ranks) {
+    for (size_t i = 0; i < n; i++) {
+        const char* pos = items[i].pos;
+        uint64_t key = 0;
+        int len = 0;
+        for (; len < 8 && pos[len]; len++) {
+            key = key << 8 | tsv_byte(pos[len]);
+        }
+        items[i].key = len == 0 ? 0 : key << (8 * (8 - len));
     }
-    
-    workbook_data[workbook_size] = '\0';
-    parse_workbook(workbook_data, &workbook);
-    free(workbook_data);
-    
-    if (workbook.sheet_count == 0) {
-        printf("No valid sheets found (sheets must contain only A-Z, a-z, 0-9, -, _, *)\n");
-        mz_zip_reader_end(&zip);
-        return 1;
+    if (n >= RANK_RADIX_MIN) {
+        radix_sort_rank_items(items, tmp, n);
+    } else {
+        qsort(items, n, sizeof(RankItem), compare_rank_items);
     }
-    
-    printf("Found %d sheet(s) to process\n\n", workbook.sheet_count);
-    
-    // Initialize shared strings
-    SharedStrings shared_strings;
-    init_shared_strings(&shared_strings);
-    
-    // Extract and parse shared strings
-    int shared_strings_index;
-    if (mz_zip_reader_locate_file(&zip, "xl/sharedStrings.xml", &shared_strings_index)) {
-        printf("Loading shared strings...\n");
-        size_t shared_strings_size = mz_zip_reader_get_file_size(&zip, shared_strings_index);
-        char* shared_strings_data = malloc(shared_strings_size + 1);
+
+    for (size_t i = 0; i < n;) {
+        size_t j = i + 1;
+        while (j < n && items[j].key == items[i].key) j++;
+        if (j - i > 1 && (items[i].key & 0xFF)) {
+            // All 8 bytes present: the strings go on
+            for (size_t k = i; k < j; k++) {
+                items[k].pos += 8;
+            }
+            rank = rank_items(items + i, tmp + i, j - i, rank, ranks);
+        } else {
+            // One string, or strings that ended here and are equal
+            for (size_t k = i; k < j; k++) {
+                ranks[items[k].index] = rank;
+            }
+            rank++;
+        }
+        i = j;
+    }
+    return rank;
+}
+
+// Collation rank of every shared string for --sort-by: ranks follow the
+// byte order of the TSV text and equal strings share a rank. NULL if out
+// of memory (keys are then compared by text)
+uint32_t* rank_shared_strings(const SharedStrings* ss) {
+    RankItem* items = malloc(sizeof(RankItem) * (ss->count + 1));
+    RankItem* tmp = malloc(sizeof(RankItem) * (ss->count + 1));
+    uint32_t* ranks = malloc(sizeof(uint32_t) * (ss->count + 1));
+    if (!items || !tmp || !ranks) {
+        free(items);
+        free(tmp);
+        free(ranks);
+        return NULL;
+    }
+    for (int i = 0; i < ss->count; i++) {
+        items[i] = (RankItem){ 0, ss->strings[i], i };
+    }
+    rank_items(items, tmp, ss->count, 0, ranks);
+    free(items);
+    free(tmp);
+    return ranks;
+}
+
+#define SORT_MEMORY_DEFAULT_MB 512
+
+// Per-job conversion options (CLI arguments or one serve request)
+typedef struct {
+    int start_row;          // 0-based
+    bool allow_wildcard;
+    bool io_uring;
+    int threads;            // shared-strings parse threads, 0 = number of CPUs
+    bool profile_columns;   // write <Sheet>.stats.json next to each .tsv
+    bool build_index;       // write <Sheet>.rowidx next to each .tsv
+    int rows_from;          // --rows query (0-based, inclusive); rows_to < 0 = no query
+    int rows_to;
+    bool stream;            // read the archive sequentially (always for input "-")
+    FilterSplit split;      // --shard-rows / --partition-by / --partitions
+    const char* diff_against;  // .rowhash of the previous run, NULL = full output
+    const char* where[MAX_WHERE];  // --where clauses, all must hold
+    int where_count;
+    const char* sort_by;    // --sort-by key columns (comma-separated), NULL = input order
+    int sort_memory_mb;     // sort memory budget, 0 = SORT_MEMORY_DEFAULT_MB
+    bool columnar;          // --format=col: <Sheet>.xcol instead of <Sheet>.tsv
+    int deadline_ms;        // --deadline: stop after this long, 0 = no limit
+    long long max_cells;    // --max-cells: stop after this many worksheet cells, 0 = no limit
+} ConvertOptions;
+
+// Options before any argument; fields not named here start as 0 / false / NULL
+static const ConvertOptions CONVERT_OPTIONS_DEFAULT = {
+    .start_row = 0,
+    .allow_wildcard = true,
+    .threads = 0,
+    .rows_to = -1,
+    .split = { .shard_rows = 0, .partitions = 1, .partition_by = NULL },
+};
+
+// Worksheet whose compressed bytes arrived before the workbook or shared strings
+typedef struct {
+    char name[MZ_STREAM_MAX_NAME];
+    int method;
+    mz_zip_buffer raw;
+} DeferredPart;
+
+// State reused across conversions (one per serve worker)
+typedef struct {
+    SharedStrings shared_strings;
+    mz_zip_buffer xml;              // extraction buffer (contents NUL-terminated)
+    RowHashFile previous_hashes;    // --diff-against input, per conversion
+    RowHashFile next_hashes;        // written back at the end
+    RowGate row_gate;               // --where clauses, per conversion
+    uint32_t* string_ranks;         // --sort-by collation ranks, per conversion
+    FilterCache filter_cache;       // the last sheet's Filter and buffers
+
+    // Held while a conversion runs; convert_abort releases them after a
+    // fatal_error in a --serve job
+    mz_zip_archive zip;
+    mz_zip_stream stream;
+    FILE* input;                    // --stream input opened by name
+    DeferredPart* deferred;         // --stream worksheets waiting for shared strings
+    int deferred_count;
+    Filter* output;                 // the sheet being written
+    RowIndex row_index;
+    char* row_xml[2];               // header and rows inflated through the row index
+} ConvertContext;
+
+void* convert_context_create(void) {
+    ConvertContext* ctx = malloc(sizeof(ConvertContext));
+    if (!ctx) {
+        fatal_error("Memory allocation failed");
+    }
+    init_shared_strings(&ctx->shared_strings);
+    ctx->xml = (mz_zip_buffer){ NULL, 0, 0 };
+    row_hash_file_init(&ctx->previous_hashes);
+    row_hash_file_init(&ctx->next_hashes);
+    memset(&ctx->row_gate, 0, sizeof(ctx->row_gate));
+    ctx->string_ranks = NULL;
+    memset(&ctx->filter_cache, 0, sizeof(ctx->filter_cache));
+    memset(&ctx->zip, 0, sizeof(ctx->zip));
+    memset(&ctx->stream, 0, sizeof(ctx->stream));
+    ctx->input = NULL;
+    ctx->deferred = NULL;
+    ctx->deferred_count = 0;
+    ctx->output = NULL;
+    memset(&ctx->row_index, 0, sizeof(ctx->row_index));
+    ctx->row_xml[0] = NULL;
+    ctx->row_xml[1] = NULL;
+    return ctx;
+}
+
+void convert_context_destroy(void* arg) {
+    ConvertContext* ctx = arg;
+    free_shared_strings(&ctx->shared_strings);
+    free(ctx->xml.data);
+    row_hash_file_free(&ctx->previous_hashes);
+    row_hash_file_free(&ctx->next_hashes);
+    row_gate_free(&ctx->row_gate);
+    free(ctx->string_ranks);
+    filter_cache_free(&ctx->filter_cache);
+    free(ctx);
+    uring_io_exit();
+}
+
+// The context's --where clauses, NULL when every row is kept
+RowGate* active_row_gate(ConvertContext* ctx) {
+    return ctx->row_gate.count > 0 ? &ctx->row_gate : NULL;
+}
+
+// Extract a zip entry into the context's reusable buffer (NUL-terminated)
+char* extract_to_context(ConvertContext* ctx, mz_zip_archive* zip, int file_index) {
+    size_t size = mz_zip_reader_get_file_size(zip, file_index);
+    if (size + 1 > ctx->xml.capacity) {
+        char* grown = realloc(ctx->xml.data, size + 1);
+        if (!grown) return NULL;
+        ctx->xml.data = grown;
+        ctx->xml.capacity = size + 1;
+    }
+    if (!mz_zip_reader_extract_to_mem(zip, file_index, ctx->xml.data, size)) {
+        return NULL;
+    }
+    ctx->xml.data[size] = '\0';
+    return ctx->xml.data;
+}
+
+// Deflate block boundaries seen while extracting a worksheet
+typedef struct {
+    size_t* out;
+    size_t* in;
+    int* bits;
+    int count;
+    int capacity;
+} InflatePoints;
+
+void collect_inflate_point(void* user, size_t out_pos, size_t in_pos, int bits) {
+    InflatePoints* points = user;
+    if (points->count >= points->capacity) {
+        points->capacity = points->capacity ? points->capacity * 2 : 1024;
+        points->out = realloc(points->out, sizeof(size_t) * points->capacity);
+        points->in = realloc(points->in, sizeof(size_t) * points->capacity);
+        points->bits = realloc(points->bits, sizeof(int) * points->capacity);
+        if (!points->out || !points->in || !points->bits) {
+            fatal_error("Memory allocation failed");
+        }
+    }
+    points->out[points->count] = out_pos;
+    points->in[points->count] = in_pos;
+    points->bits[points->count] = bits;
+    points->count++;
+}
+
+// Extract a worksheet into the context buffer and build its row index from
+// the block boundaries: keep a boundary once ROWIDX_INTERVAL rows have
+// passed since the previous checkpoint.
+char* extract_with_row_index(ConvertContext* ctx, mz_zip_archive* zip, int file_index, RowIndex* index) {
+    size_t size = mz_zip_reader_get_file_size(zip, file_index);
+    if (size + 1 > ctx->xml.capacity) {
+        char* grown = realloc(ctx->xml.data, size + 1);
+        if (!grown) return NULL;
+        ctx->xml.data = grown;
+        ctx->xml.capacity = size + 1;
+    }
+    
+    InflatePoints points = { NULL, NULL, NULL, 0, 0 };
+    if (!mz_zip_reader_extract_to_mem_points(zip, file_index, ctx->xml.data, size,
+                                             collect_inflate_point, &points)) {
+        free(points.out);
+        free(points.in);
+        free(points.bits);
+        return NULL;
+    }
+    char* xml = ctx->xml.data;
+    xml[size] = '\0';
+    
+    mz_zip_central_dir_entry* entry = &zip->entries[file_index];
+    row_index_init(index, entry->crc32, entry->comp_size, entry->uncomp_size);
+    for (int i = 0; i < points.count; i++) {
+        const char* tag = NULL;
+        int row = next_row_tag(xml + points.out[i], NULL, &tag);
+        if (row < 0) break;
+        if (index->count > 0 && row < index->points[index->count - 1].row + ROWIDX_INTERVAL) continue;
+        
+        size_t window_len = points.out[i] < ROWIDX_WINDOW ? points.out[i] : ROWIDX_WINDOW;
+        row_index_add(index, row, (uint64_t)(tag - xml), points.out[i], points.in[i], points.bits[i],
+                      (const unsigned char*)xml + points.out[i] - window_len, (uint32_t)window_len);
+    }
+    
+    free(points.out);
+    free(points.in);
+    free(points.bits);
+    return xml;
+}
+
+// Load <Sheet>.rowidx if it was built from this exact worksheet entry
+int load_row_index(mz_zip_archive* zip, int file_index, const char* filename, RowIndex* index) {
+    if (!row_index_load(index, filename)) return 0;
+    
+    mz_zip_central_dir_entry* entry = &zip->entries[file_index];
+    if (index->crc32 != entry->crc32 || index->comp_size != entry->comp_size ||
+        index->uncomp_size != entry->uncomp_size || index->count == 0) {
+        row_index_free(index);
+        return 0;
+    }
+    return 1;
+}
+
+// Does xml[from..to) contain a cell?
+static bool has_cell(const char* from, const char* to) {
+    const char* cell = strstr(from, "<c ");
+    return cell && cell < to;
+}
+
+// Inflate from a checkpoint until the first row after last_row, or with
+// header_from >= 0, until the first row at or after header_from that has a
+// cell is complete. Returns a NUL-terminated buffer whose XML starts at the
+// checkpoint's <row> tag.
+static char* inflate_rows_until(mz_zip_archive* zip, int file_index, const RowCheckpoint* point, int last_row,
+                                int header_from) {
+    mz_zip_inflate_cursor cursor;
+    if (!mz_zip_reader_inflate_open(zip, file_index, point->in, point->bits,
+                                    point->window, point->window_len, &cursor)) {
+        return NULL;
+    }
+    
+    size_t skip = point->row_out - point->out;
+    size_t capacity = MZ_INFLATE_CHUNK * 4 + skip;
+    size_t len = 0;
+    size_t scan = skip;
+    char* buf = malloc(capacity + 1);
+    if (header_from >= 0) last_row = INT_MAX;
+    ptrdiff_t header_tag = -1;  // header candidate: <row> tag at or after header_from
+    int header_row = -1;
+    
+    while (buf) {
+        if (capacity - len < MZ_INFLATE_CHUNK) {
+            capacity *= 2;
+            char* grown = realloc(buf, capacity + 1);
+            if (!grown) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+        }
         
-        if (mz_zip_reader_extract_to_mem(&zip, shared_strings_index, shared_strings_data, shared_strings_size)) {
-            shared_strings_data[shared_strings_size] = '\0';
-            parse_shared_strings(shared_strings_data, &shared_strings);
-            printf("Loaded %d shared strings\n\n", shared_strings.count);
+        long n = mz_zip_reader_inflate_read(&cursor, buf + len, capacity - len);
+        if (n < 0) {
+            free(buf);
+            buf = NULL;
+            break;
         }
+        len += (size_t)n;
+        buf[len] = '\0';
         
-        free(shared_strings_data);
+        // Stop at the first complete <row> tag past last_row
+        const char* tag = NULL;
+        int row = -1;
+        while (scan < len && (row = next_row_tag(buf + scan, buf + len, &tag)) >= 0 && row <= last_row) {
+            if (header_from >= 0 && header_tag >= 0 && has_cell(buf + header_tag, tag)) {
+                last_row = header_row;  // header complete: stop at this tag
+                break;
+            }
+            if (header_from >= 0 && row >= header_from) {
+                header_tag = tag - buf;
+                header_row = row;
+            } else {
+                header_tag = -1;
+            }
+            scan = (size_t)(tag - buf) + 4;
+        }
+        if (row > last_row) {
+            buf[tag - buf] = '\0';
+            break;
+        }
+        if (n == 0) break;
+        if (len > scan + 256) scan = len - 256;  // rescan a possibly cut-off tag
     }
     
+    mz_zip_reader_inflate_close(&cursor);
+    if (buf && skip > 0) memmove(buf, buf + skip, strlen(buf + skip) + 1);
+    return buf;
+}
+
+char* inflate_rows(mz_zip_archive* zip, int file_index, const RowCheckpoint* point, int last_row) {
+    return inflate_rows_until(zip, file_index, point, last_row, -1);
+}
+
+// Inflate from a checkpoint through the header row (see first_cell_row)
+char* inflate_header_row(mz_zip_archive* zip, int file_index, const RowCheckpoint* point, int start_row) {
+    return inflate_rows_until(zip, file_index, point, INT_MAX, start_row);
+}
+
+// Parse one conversion option; returns 0 for an unknown option
+int parse_convert_option(const char* arg, ConvertOptions* opts) {
+    if (strcmp(arg, "--no-wildcard") == 0) {
+        opts->allow_wildcard = false;
+    } else if (strcmp(arg, "--io-uring") == 0) {
+        opts->io_uring = true;
+    } else if (strcmp(arg, "--profile-columns") == 0) {
+        opts->profile_columns = true;
+    } else if (strcmp(arg, "--stream") == 0) {
+        opts->stream = true;
+    } else if (strcmp(arg, "--build-index") == 0) {
+        opts->build_index = true;
+    } else if (strncmp(arg, "--rows=", 7) == 0) {
+        int from, to;
+        if (sscanf(arg + 7, "%d:%d", &from, &to) != 2 || from < 1 || to < from) return 0;
+        opts->rows_from = from - 1;
+        opts->rows_to = to - 1;
+    } else if (strncmp(arg, "--shard-rows=", 13) == 0) {
+        opts->split.shard_rows = atoi(arg + 13);
+        if (opts->split.shard_rows < 1) return 0;
+    } else if (strncmp(arg, "--partition-by=", 15) == 0) {
+        opts->split.partition_by = arg + 15;
+    } else if (strncmp(arg, "--partitions=", 13) == 0) {
+        opts->split.partitions = atoi(arg + 13);
+        if (opts->split.partitions < 1 || opts->split.partitions > FILTER_MAX_PARTITIONS) return 0;
+    } else if (strncmp(arg, "--diff-against=", 15) == 0) {
+        opts->diff_against = arg + 15;
+        if (!*opts->diff_against) return 0;
+    } else if (strncmp(arg, "--where=", 8) == 0) {
+        char column[MAX_SHEET_NAME];
+        WhereOp op;
+        const char* operand;
+        if (opts->where_count >= MAX_WHERE || !where_split(arg + 8, column, sizeof(column), &op, &operand)) return 0;
+        opts->where[opts->where_count++] = arg + 8;
+    } else if (strncmp(arg, "--sort-by=", 10) == 0) {
+        opts->sort_by = arg + 10;
+        if (!*opts->sort_by) return 0;
+    } else if (strncmp(arg, "--sort-memory=", 14) == 0) {
+        opts->sort_memory_mb = atoi(arg + 14);
+        if (opts->sort_memory_mb < 1) return 0;
+    } else if (strcmp(arg, "--format=col") == 0) {
+        opts->columnar = true;
+    } else if (strcmp(arg, "--format=tsv") == 0) {
+        opts->columnar = false;
+    } else if (strncmp(arg, "--deadline=", 11) == 0) {
+        opts->deadline_ms = atoi(arg + 11);
+        if (opts->deadline_ms < 1) return 0;
+    } else if (strncmp(arg, "--max-cells=", 12) == 0) {
+        opts->max_cells = atoll(arg + 12);
+        if (opts->max_cells < 1) return 0;
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+        opts->threads = atoi(arg + 10);
+    } else if (strncmp(arg, "--", 2) == 0) {
+        return 0;
+    } else {
+        opts->start_row = atoi(arg) - 1;  // Convert to 0-based
+        if (opts->start_row < 0) opts->start_row = 0;
+    }
+    return 1;
+}
+
+double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Progress goes to log and per-sheet status lines to report (either may be NULL)
+#define LOG(...) do { if (log) fprintf(log, __VA_ARGS__); } while (0)
+#define REPORT(...) do { if (report) fprintf(report, __VA_ARGS__); } while (0)
+
+// Fill workbook from workbook.xml or workbook.bin
+void load_workbook(const char* data, size_t size, bool is_xlsb, Workbook* workbook) {
+    if (is_xlsb) {
+        workbook->sheet_count = 0;
+        xlsb_parse_workbook((const unsigned char*)data, size, xlsb_add_sheet, workbook);
+    } else {
+        parse_workbook(data, workbook);
+    }
+}
+
+// Fill ss from sharedStrings.xml or sharedStrings.bin
+void load_shared_strings(const char* data, size_t size, bool is_xlsb, SharedStrings* ss,
+                         const ConvertOptions* opts, FILE* log) {
+    double parse_start_ms = monotonic_ms();
+    if (is_xlsb) {
+        xlsb_parse_shared_strings((const unsigned char*)data, size, xlsb_add_shared_string, ss);
+        LOG("Loaded %d shared strings (%.1f ms)\n\n", ss->count, monotonic_ms() - parse_start_ms);
+    } else {
+        int threads = opts->threads > 0 ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        parse_shared_strings_parallel(data, size, ss, threads);
+        LOG("Loaded %d shared strings (%.1f ms, %d thread(s))\n\n", ss->count,
+            monotonic_ms() - parse_start_ms, threads);
+    }
+}
+
+// <output_dir>/<Sheet>.tsv, or <Sheet>.tsv in the current directory
+void sheet_output_filename(const char* sheet_name, const char* output_dir, char* out, size_t out_size) {
+    char safe_filename[MAX_SHEET_NAME + 10];
+    create_safe_filename(sheet_name, safe_filename, sizeof(safe_filename));
+    if (output_dir) {
+        snprintf(out, out_size, "%s/%s", output_dir, safe_filename);
+    } else {
+        snprintf(out, out_size, "%s", safe_filename);
+    }
+}
+
+// Create the sheet's TSV (and <Sheet>.stats.json with --profile-columns).
+// With --diff-against the rows go to <Sheet>.delta.tsv instead.
+Filter* open_sheet_output(ConvertContext* ctx, const char* sheet_name, const char* output_filename,
+                          const ConvertOptions* opts, FILE* log, FILE* report) {
+    char data_filename[PATH_MAX];
+    snprintf(data_filename, sizeof(data_filename), "%s", output_filename);
+    if (opts->diff_against) {
+        snprintf(data_filename, sizeof(data_filename), "%.*s.delta.tsv",
+                 (int)(strlen(output_filename) - 4), output_filename);
+    }
+
+    if (opts->columnar) {
+        snprintf(data_filename, sizeof(data_filename), "%.*s.xcol", (int)(strlen(output_filename) - 4),
+                 output_filename);
+    }
+
+    Filter* output = filter_init_split(data_filename, &opts->split, &ctx->filter_cache);
+    if (!output) {
+        LOG("Warning: Could not create output file: %s - skipping\n\n", data_filename);
+        REPORT("sheet\t%s\tskipped\tcannot create %s\n", sheet_name, data_filename);
+        return NULL;
+    }
+    ctx->output = output;
+    output->log = log;
+
+    if (output->split) {
+        LOG("  Output files: %s split into %d file(s)%s\n", data_filename, output->file_count,
+            opts->split.shard_rows > 0 ? ", more as shards fill" : "");
+    } else {
+        LOG("  Output file: %s\n", data_filename);
+    }
+
+    if (opts->diff_against) {
+        const RowHashSheet* previous = row_hash_file_find(&ctx->previous_hashes, sheet_name);
+        if (!filter_enable_delta(output, previous ? previous->hashes : NULL, previous ? previous->count : 0)) {
+            LOG("Error: Memory allocation failed\n");
+            REPORT("sheet\t%s\tskipped\tout of memory\n", sheet_name);
+            filter_close(output);
+            ctx->output = NULL;
+            return NULL;
+        }
+        LOG("  Diff against: %zu previous row(s)\n", previous ? previous->count : 0);
+    }
+
+    if (opts->columnar) {
+        if (!filter_enable_columnar(output, ctx->shared_strings.count)) {
+            LOG("Error: Memory allocation failed\n");
+            REPORT("sheet\t%s\tskipped\tout of memory\n", sheet_name);
+            filter_close(output);
+            ctx->output = NULL;
+            return NULL;
+        }
+        LOG("  Format: columnar\n");
+    }
+
+    if (opts->sort_by) {
+        // Ranks are built once per workbook, when the first sheet needs them
+        SharedStrings* ss = &ctx->shared_strings;
+        if (!ctx->string_ranks) {
+            double rank_start_ms = monotonic_ms();
+            ctx->string_ranks = rank_shared_strings(ss);
+            LOG("  Ranked %d shared strings for sorting (%.1f ms)\n", ss->count, monotonic_ms() - rank_start_ms);
+        }
+        int memory_mb = opts->sort_memory_mb > 0 ? opts->sort_memory_mb : SORT_MEMORY_DEFAULT_MB;
+        int threads = opts->threads > 0 ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (!filter_enable_sort(output, opts->sort_by, (size_t)memory_mb << 20, threads, ctx->string_ranks,
+                                ctx->string_ranks ? ss->count : 0)) {
+            LOG("Error: Memory allocation failed\n");
+            REPORT("sheet\t%s\tskipped\tout of memory\n", sheet_name);
+            filter_close(output);
+            ctx->output = NULL;
+            return NULL;
+        }
+        LOG("  Sort by: %s (%d MB in memory, %d thread(s))\n", opts->sort_by, memory_mb, threads);
+    }
+
+    if (opts->profile_columns) {
+        // <Sheet>.tsv -> <Sheet>.stats.json
+        char stats_filename[PATH_MAX];
+        snprintf(stats_filename, sizeof(stats_filename), "%.*s.stats.json",
+                 (int)(strlen(output_filename) - 4), output_filename);
+        if (filter_enable_stats(output, stats_filename)) {
+            LOG("  Stats file: %s\n", stats_filename);
+        }
+    }
+    return output;
+}
+
+// Parse a whole worksheet part: every row from start_row, or the header
+// row plus rows_from..rows_to for --rows
+void parse_sheet_data(const char* data, size_t size, bool is_xlsb, SharedStrings* ss,
+                      const ConvertOptions* opts, RowGate* gate, Filter* output) {
+    int start_row = opts->start_row;
+    row_gate_begin_sheet(gate, ss);
+    if (opts->rows_to < 0) {
+        if (is_xlsb) {
+            parse_worksheet_bin(data, size, ss, start_row, INT_MAX, gate, output);
+        } else {
+            parse_worksheet(data, ss, start_row, gate, output);
+        }
+        return;
+    }
+
+    // The header is the first row with a cell at or after start_row, as
+    // without --rows; data rows start after it
+    int header_row = is_xlsb ? first_cell_row_bin(data, size, ss, start_row) : first_cell_row(data, start_row);
+    if (header_row < 0) return;
+    int rows_from = opts->rows_from > header_row ? opts->rows_from : header_row + 1;
+    if (is_xlsb) {
+        parse_worksheet_bin(data, size, ss, header_row, header_row, gate, output);
+        parse_worksheet_bin(data, size, ss, rows_from, opts->rows_to, gate, output);
+    } else {
+        parse_worksheet_rows(data, ss, header_row, header_row, gate, output);
+        parse_worksheet_rows(data, ss, rows_from, opts->rows_to, gate, output);
+    }
+}
+
+// Bytes of a worksheet inflated only in part (the budget ran out) that hold
+// complete rows; xml data is cut after its last </row>. 0 if there are none
+size_t complete_rows_size(char* data, size_t size, bool is_xlsb) {
+    if (is_xlsb) return xlsb_complete_rows_size((const unsigned char*)data, size);
+    for (size_t end = size; end >= 6; end--) {
+        if (memcmp(data + end - 6, "</row>", 6) == 0) {
+            data[end] = '\0';
+            return end;
+        }
+    }
+    return 0;
+}
+
+// Parse the complete rows of a worksheet whose inflate the budget cut short.
+// The conversion has already stopped, so they are parsed without budget
+// checks, and the sheet is marked truncated.
+void parse_partial_sheet_data(const char* data, size_t size, bool is_xlsb, SharedStrings* ss,
+                              const ConvertOptions* opts, RowGate* gate, Filter* output) {
+    Budget stopped = BUDGET;
+    budget_start(0, 0);
+    parse_sheet_data(data, size, is_xlsb, ss, opts, gate, output);
+    stopped.cells += BUDGET.cells;
+    BUDGET = stopped;
+    output->truncated = true;
+}
+
+void close_sheet_output(ConvertContext* ctx, Filter* output, const char* sheet_name,
+                        double sheet_start_ms, FILE* log, FILE* report) {
+    char delta[64] = "";
+    if (output->delta) {
+        // Row hashes of this run become the next run's --diff-against input;
+        // a truncated sheet keeps the previous ones
+        size_t count;
+        uint64_t* hashes = filter_finish_delta(output, &count);
+        if (output->truncated) {
+            free(hashes);
+        } else {
+            row_hash_file_add(&ctx->next_hashes, sheet_name, hashes, count);
+        }
+        LOG("  Delta: %lld added, %lld removed\n", output->delta_added, output->delta_removed);
+        snprintf(delta, sizeof(delta), "\tadded=%lld\tremoved=%lld", output->delta_added, output->delta_removed);
+    }
+
+    if (output->sort) {
+        filter_finish_sort(output);
+        if (output->sort_runs > 0) LOG("  Sort: merged %d run(s) spilled to disk\n", output->sort_runs);
+    }
+
+    char data_filename[PATH_MAX];
+    snprintf(data_filename, sizeof(data_filename), "%s", output->base_filename);
+    int rows = output->row_count;
+    long long bytes = filter_bytes(output);
+    int files = output->file_count;
+    char truncated[32] = "";
+    if (output->truncated) {
+        snprintf(truncated, sizeof(truncated), "\ttruncated=%s", budget_stop_name());
+    }
+
+    filter_close(output);
+    ctx->output = NULL;
+
+    if (files > 1) LOG("  Wrote %d file(s)\n", files);
+    if (truncated[0]) {
+        LOG("  Sheet '%s' truncated after %d row(s): --%s reached\n\n", sheet_name, rows, budget_stop_name());
+    } else {
+        LOG("  Sheet '%s' processed successfully!\n\n", sheet_name);
+    }
+    REPORT("sheet\t%s\tok\t%s\trows=%d\tbytes=%lld\tfiles=%d%s%s\tms=%.1f\n", sheet_name,
+           data_filename, rows, bytes, files, delta, truncated, monotonic_ms() - sheet_start_ms);
+}
+
+// A sheet not started because --deadline / --max-cells stopped the conversion
+void skip_sheet_over_budget(const char* sheet_name, FILE* log, FILE* report) {
+    LOG("Skipping sheet '%s': --%s reached\n\n", sheet_name, budget_stop_name());
+    REPORT("sheet\t%s\tskipped\t%s\n", sheet_name, budget_stop_name());
+}
+
+// Load the --diff-against hashes for a new conversion
+void begin_row_hashes(ConvertContext* ctx, const ConvertOptions* opts, FILE* log) {
+    row_hash_file_free(&ctx->previous_hashes);
+    row_hash_file_free(&ctx->next_hashes);
+    if (!opts->diff_against) return;
+
+    if (row_hash_file_load(&ctx->previous_hashes, opts->diff_against)) {
+        LOG("Diff against: %s (%d sheet(s))\n", opts->diff_against, ctx->previous_hashes.count);
+    } else {
+        LOG("Diff against: %s not found - every row is new\n", opts->diff_against);
+    }
+}
+
+// Replace the --diff-against file with this run's hashes; sheets that were
+// not converted this time keep their previous hashes
+void save_row_hashes(ConvertContext* ctx, const ConvertOptions* opts, FILE* log) {
+    if (!opts->diff_against) return;
+
+    RowHashFile* previous = &ctx->previous_hashes;
+    for (int i = 0; i < previous->count; i++) {
+        if (row_hash_file_find(&ctx->next_hashes, previous->sheets[i].name)) continue;
+        row_hash_file_add(&ctx->next_hashes, previous->sheets[i].name, previous->sheets[i].hashes,
+                          previous->sheets[i].count);
+        previous->sheets[i].hashes = NULL;
+    }
+
+    if (row_hash_file_save(&ctx->next_hashes, opts->diff_against)) {
+        LOG("Row hashes saved: %s\n", opts->diff_against);
+    } else {
+        LOG("Warning: Could not write row hashes: %s\n", opts->diff_against);
+    }
+    row_hash_file_free(previous);
+    row_hash_file_free(&ctx->next_hashes);
+}
+
+// Summary lines shared by the file and stream paths; returns the exit code
+int finish_conversion(const Workbook* workbook, int processed_sheets, int shared_string_count,
+                      const ConvertOptions* opts, clock_t start_time, double start_ms, FILE* log, FILE* report) {
+    clock_t end_time = clock();
+    double elapsed = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
+
+    const char* status = BUDGET.stop != BUDGET_OK ? "truncated" : processed_sheets > 0 ? "ok" : "failed";
+    LOG("=== Conversion Summary ===\n");
+    LOG("Total sheets processed: %d out of %d\n", processed_sheets, workbook->sheet_count);
+    LOG("Processing time: %.2f seconds\n", elapsed);
+    REPORT("done\t%s\tsheets=%d/%d\tshared_strings=%d\tms=%.1f\n", status, processed_sheets,
+           workbook->sheet_count, shared_string_count, monotonic_ms() - start_ms);
+
+    if (BUDGET.stop != BUDGET_OK) {
+        LOG("Stopped early: --%s reached after %lld cell(s) - output is truncated\n", budget_stop_name(),
+            BUDGET.cells);
+    } else if (processed_sheets > 0) {
+        LOG("Conversion completed successfully!\n");
+    }
+    if (processed_sheets > 0) {
+        LOG("Output files created:\n");
+        for (int i = 0; i < workbook->sheet_count; i++) {
+            char output_filename[MAX_SHEET_NAME + 10];
+            create_safe_filename(workbook->sheets[i].name, output_filename, sizeof(output_filename));
+            if (opts->split.shard_rows > 0 || opts->split.partitions > 1) {
+                // <Sheet>.tsv -> <Sheet>.*.tsv
+                LOG("  - %.*s.*.tsv (from sheet: %s)\n", (int)strlen(output_filename) - 4, output_filename,
+                    workbook->sheets[i].name);
+            } else if (opts->columnar) {
+                LOG("  - %.*s.xcol (from sheet: %s)\n", (int)strlen(output_filename) - 4, output_filename,
+                    workbook->sheets[i].name);
+            } else {
+                LOG("  - %s (from sheet: %s)\n", output_filename, workbook->sheets[i].name);
+            }
+        }
+    } else if (BUDGET.stop == BUDGET_OK) {
+        LOG("No sheets were processed successfully.\n");
+        return 1;
+    }
+    return BUDGET.stop != BUDGET_OK ? EXIT_TRUNCATED : 0;
+}
+
+// *** streaming input
+
+// Index of the workbook sheet stored in part_name, or -1 (skipped sheet)
+int find_workbook_sheet(const Workbook* workbook, const char* part_name) {
+    for (int i = 0; i < workbook->sheet_count; i++) {
+        if (strcmp(workbook->sheets[i].filename, part_name) == 0) return i;
+    }
+    return -1;
+}
+
+// After an extract failed: keep the complete rows of a part the budget cut
+// short, false for other failures or when no row is complete
+static bool keep_partial_part(mz_zip_buffer* part, bool is_xlsb) {
+    if (BUDGET.stop == BUDGET_OK || !part->data) return false;
+    part->size = complete_rows_size(part->data, part->size, is_xlsb);
+    return part->size > 0;
+}
+
+// Write one extracted worksheet part to <Sheet>.tsv; returns 1 on success.
+// partial: the budget cut the part short (see keep_partial_part)
+int convert_sheet_part(ConvertContext* ctx, const SheetInfo* sheet, const char* data, size_t size, bool is_xlsb,
+                       bool partial, const char* output_dir, const ConvertOptions* opts, FILE* log, FILE* report) {
+    LOG("Processing sheet '%s' (%s)\n", sheet->name, sheet->filename);
+    double sheet_start_ms = monotonic_ms();
+
+    char output_filename[PATH_MAX];
+    sheet_output_filename(sheet->name, output_dir, output_filename, sizeof(output_filename));
+    Filter* output = open_sheet_output(ctx, sheet->name, output_filename, opts, log, report);
+    if (!output) return 0;
+
+    if (partial) {
+        LOG("  Inflate stopped by --%s: converting the complete rows so far\n", budget_stop_name());
+        parse_partial_sheet_data(data, size, is_xlsb, &ctx->shared_strings, opts, active_row_gate(ctx), output);
+    } else {
+        parse_sheet_data(data, size, is_xlsb, &ctx->shared_strings, opts, active_row_gate(ctx), output);
+    }
+    close_sheet_output(ctx, output, sheet->name, sheet_start_ms, log, report);
+    return 1;
+}
+
+// Convert an archive read front to back from a pipe, without seeking and
+// without a copy of the input. Parts are handled in archive order: a
+// worksheet is converted as soon as it has arrived if the workbook and the
+// shared strings are already known (or [Content_Types].xml says there are
+// none); otherwise only its compressed bytes are kept until the end.
+int convert_workbook_stream(ConvertContext* ctx, FILE* input, const char* output_dir,
+                            const ConvertOptions* opts, FILE* log, FILE* report) {
+    clock_t start_time = clock();
+    double start_ms = monotonic_ms();
+    if (opts->build_index) {
+        LOG("Warning: Row index needs a seekable file - --build-index ignored\n");
+    }
+
+    mz_zip_stream* stream = &ctx->stream;
+    if (!mz_zip_stream_init(stream, input)) {
+        LOG("Error: Memory allocation failed\n");
+        REPORT("error out of memory\n");
+        return 1;
+    }
+
+    Workbook workbook;
+    workbook.sheet_count = 0;
+    bool have_workbook = false;
+    bool have_shared_strings = false;
+    int expect_shared_strings = -1;  // unknown until [Content_Types].xml
+    bool is_xlsb = false;
+
+    SharedStrings* shared_strings = &ctx->shared_strings;
+    clear_shared_strings(shared_strings);
+    mz_zip_buffer* part = &ctx->xml;
+    part->size = 0;
+
+    int processed_sheets = 0;
+    bool converted[MAX_SHEETS] = { false };  // sheets already handed to convert_sheet_part
+
+    int status;
+    while ((status = mz_zip_stream_next(stream)) > 0) {
+        if (budget_check()) break;
+        const char* name = stream->name;
+        bool is_worksheet = strncmp(name, "xl/worksheets/sheet", 19) == 0;
+        bool sheets_ready = have_workbook && (have_shared_strings || expect_shared_strings == 0);
+
+        if (strcmp(name, "[Content_Types].xml") == 0) {
+            if (!mz_zip_stream_extract(stream, part)) break;
+            expect_shared_strings = strstr(part->data, "/xl/sharedStrings.") != NULL;
+        } else if (strcmp(name, "xl/workbook.xml") == 0 || strcmp(name, "xl/workbook.bin") == 0) {
+            if (!mz_zip_stream_extract(stream, part)) break;
+            is_xlsb = strcmp(name, "xl/workbook.bin") == 0;
+            if (is_xlsb) LOG("Binary workbook (xlsb)\n");
+            load_workbook(part->data, part->size, is_xlsb, &workbook);
+            have_workbook = true;
+            LOG("Found %d sheet(s) to process\n\n", workbook.sheet_count);
+        } else if (strcmp(name, "xl/sharedStrings.xml") == 0 || strcmp(name, "xl/sharedStrings.bin") == 0) {
+            LOG("Loading shared strings...\n");
+            if (!mz_zip_stream_extract(stream, part)) break;
+            load_shared_strings(part->data, part->size, strcmp(name, "xl/sharedStrings.bin") == 0,
+                                shared_strings, opts, log);
+            have_shared_strings = true;
+        } else if (is_worksheet && !sheets_ready) {
+            DeferredPart* grown = realloc(ctx->deferred, sizeof(DeferredPart) * (ctx->deferred_count + 1));
+            if (!grown) break;
+            ctx->deferred = grown;
+            DeferredPart* pending = &ctx->deferred[ctx->deferred_count];
+            snprintf(pending->name, sizeof(pending->name), "%s", name);
+            pending->method = stream->method;
+            pending->raw = (mz_zip_buffer){ NULL, 0, 0 };
+            ctx->deferred_count++;
+            if (!mz_zip_stream_read_raw(stream, &pending->raw)) break;
+            LOG("Buffering %s until shared strings arrive (%zu compressed bytes)\n", name, pending->raw.size);
+        } else if (is_worksheet) {
+            int sheet = find_workbook_sheet(&workbook, name);
+            if (sheet < 0) continue;  // data is skipped by the next header read
+            bool complete = mz_zip_stream_extract(stream, part);
+            if (!complete && !keep_partial_part(part, is_xlsb)) break;
+            converted[sheet] = true;
+            processed_sheets += convert_sheet_part(ctx, &workbook.sheets[sheet], part->data, part->size, is_xlsb,
+                                                   !complete, output_dir, opts, log, report);
+            if (!complete) break;
+        }
+    }
+    // An extraction cut short by the budget is not an archive error
+    if (BUDGET.stop != BUDGET_OK) status = 0;
+    if (status != 0) {
+        LOG("Error: Truncated or unsupported archive (at %s)\n", stream->name[0] ? stream->name : "start");
+        REPORT("error truncated or unsupported archive\n");
+    }
+    mz_zip_stream_end(stream);
+
+    // Worksheets that came before the workbook or shared strings
+    for (int i = 0; i < ctx->deferred_count; i++) {
+        DeferredPart* pending = &ctx->deferred[i];
+        int sheet = status == 0 && !budget_check() ? find_workbook_sheet(&workbook, pending->name) : -1;
+        bool complete = sheet >= 0 && mz_zip_inflate_mem(pending->raw.data, pending->raw.size, pending->method, part);
+        if (sheet >= 0 && (complete || keep_partial_part(part, is_xlsb))) {
+            converted[sheet] = true;
+            processed_sheets += convert_sheet_part(ctx, &workbook.sheets[sheet], part->data, part->size, is_xlsb,
+                                                   !complete, output_dir, opts, log, report);
+        } else if (sheet >= 0 && BUDGET.stop == BUDGET_OK) {
+            LOG("Warning: Could not extract worksheet data for: %s - skipping\n\n", workbook.sheets[sheet].name);
+            REPORT("sheet\t%s\tskipped\textract failed\n", workbook.sheets[sheet].name);
+        }
+        free(pending->raw.data);
+        pending->raw.data = NULL;
+    }
+    free(ctx->deferred);
+    ctx->deferred = NULL;
+    ctx->deferred_count = 0;
+    for (int i = 0; i < workbook.sheet_count && BUDGET.stop != BUDGET_OK; i++) {
+        if (!converted[i]) skip_sheet_over_budget(workbook.sheets[i].name, log, report);
+    }
+
+    if (status != 0) return 1;
+    if (!have_workbook && BUDGET.stop == BUDGET_OK) {
+        LOG("Error: Could not find workbook.xml in XLSX file\n");
+        REPORT("error workbook.xml not found\n");
+        return 1;
+    }
+    save_row_hashes(ctx, opts, log);
+    return finish_conversion(&workbook, processed_sheets, shared_strings->count, opts, start_time, start_ms, log, report);
+}
+
+// *** streaming input END
+
+// Convert every valid sheet of input_file into <output_dir>/<Sheet>.tsv.
+// input_file "-" (or --stream) reads the archive sequentially instead.
+int convert_workbook(ConvertContext* ctx, const char* input_file, const char* output_dir,
+                     const ConvertOptions* opts, FILE* log, FILE* report) {
+    int start_row = opts->start_row;
+    ALLOW_WILD_CARD = opts->allow_wildcard;
+    USE_IO_URING = opts->io_uring;
+    if (USE_IO_URING && !uring_io_init()) {
+        LOG("Warning: io_uring not available - using synchronous writes\n");
+        USE_IO_URING = false;
+    }
+
+    LOG("Converting XLSX to multiple TSV files...\n");
+    LOG("Input: %s\n", input_file);
+    LOG("Starting from row: %d\n", start_row + 1);
+
+    if (opts->columnar && (opts->split.shard_rows > 0 || opts->split.partitions > 1 || opts->diff_against ||
+                           opts->sort_by)) {
+        LOG("Error: --format=col cannot be combined with --shard-rows, --partitions, --diff-against or --sort-by\n");
+        REPORT("error --format=col cannot be combined with split, delta or sorted output\n");
+        return 1;
+    }
+    if (opts->split.partition_by && opts->split.partitions <= 1) {
+        LOG("Error: --partition-by needs --partitions=K with K > 1\n");
+        REPORT("error --partition-by needs --partitions=K with K > 1\n");
+        return 1;
+    }
+    // The saved hashes are the whole sheet; a filtered run would diff and save only part of it
+    if (opts->diff_against && (opts->where_count > 0 || opts->rows_to >= 0)) {
+        LOG("Error: --diff-against cannot be combined with --where or --rows\n");
+        REPORT("error --diff-against cannot be combined with --where or --rows\n");
+        return 1;
+    }
+
+    // The deadline counts from here, including reading the archive
+    budget_start(opts->deadline_ms, opts->max_cells);
+    if (opts->deadline_ms > 0) LOG("Deadline: %d ms\n", opts->deadline_ms);
+    if (opts->max_cells > 0) LOG("Max cells: %lld\n", opts->max_cells);
+
+    begin_row_hashes(ctx, opts, log);
+    row_gate_setup(&ctx->row_gate, opts->where, opts->where_count, log);
+    free(ctx->string_ranks);
+    ctx->string_ranks = NULL;
+    for (int i = 0; i < opts->where_count; i++) {
+        LOG("Where: %s\n", opts->where[i]);
+    }
+
+    bool from_stdin = strcmp(input_file, "-") == 0;
+    if (from_stdin || opts->stream) {
+        FILE* input = from_stdin ? stdin : fopen(input_file, "rb");
+        if (!input) {
+            LOG("Error: Could not open XLSX file: %s\n", input_file);
+            REPORT("error could not open %s\n", input_file);
+            return 1;
+        }
+        if (!from_stdin) ctx->input = input;
+        int result = convert_workbook_stream(ctx, input, output_dir, opts, log, report);
+        if (!from_stdin) fclose(input);
+        ctx->input = NULL;
+        return result;
+    }
+
+    clock_t start_time = clock();
+    double start_ms = monotonic_ms();
+
+    // Open XLSX file
+    mz_zip_archive* zip = &ctx->zip;
+    if (!mz_zip_reader_init_file(zip, input_file)) {
+        LOG("Error: Could not open XLSX file: %s\n", input_file);
+        REPORT("error could not open %s\n", input_file);
+        return 1;
+    }
+
+    // Initialize workbook and parse sheet information
+    // Binary workbooks (.xlsb) have xl/workbook.bin instead
+    Workbook workbook;
+    int workbook_index;
+    bool is_xlsb = false;
+    if (!mz_zip_reader_locate_file(zip, "xl/workbook.xml", &workbook_index)) {
+        if (!mz_zip_reader_locate_file(zip, "xl/workbook.bin", &workbook_index)) {
+            LOG("Error: Could not find workbook.xml in XLSX file\n");
+            REPORT("error workbook.xml not found\n");
+            mz_zip_reader_end(zip);
+            return 1;
+        }
+        is_xlsb = true;
+        LOG("Binary workbook (xlsb)\n");
+    }
+
+    char* workbook_data = extract_to_context(ctx, zip, workbook_index);
+    if (!workbook_data && BUDGET.stop != BUDGET_OK) {
+        mz_zip_reader_end(zip);
+        workbook.sheet_count = 0;
+        return finish_conversion(&workbook, 0, 0, opts, start_time, start_ms, log, report);
+    }
+    if (!workbook_data) {
+        LOG("Error: Could not extract %s\n", is_xlsb ? "workbook.bin" : "workbook.xml");
+        REPORT("error could not extract %s\n", is_xlsb ? "workbook.bin" : "workbook.xml");
+        mz_zip_reader_end(zip);
+        return 1;
+    }
+    load_workbook(workbook_data, mz_zip_reader_get_file_size(zip, workbook_index), is_xlsb, &workbook);
+
+    if (workbook.sheet_count == 0) {
+        LOG("No valid sheets found (sheets must contain only A-Z, a-z, 0-9, -, _, *)\n");
+        REPORT("error no valid sheets\n");
+        mz_zip_reader_end(zip);
+        return 1;
+    }
+
+    LOG("Found %d sheet(s) to process\n\n", workbook.sheet_count);
+
+    // Reset shared strings left over from a previous conversion
+    SharedStrings* shared_strings = &ctx->shared_strings;
+    clear_shared_strings(shared_strings);
+
+    // Extract and parse shared strings
+    int shared_strings_index;
+    if (mz_zip_reader_locate_file(zip, is_xlsb ? "xl/sharedStrings.bin" : "xl/sharedStrings.xml",
+                                  &shared_strings_index)) {
+        LOG("Loading shared strings...\n");
+        char* shared_strings_data = extract_to_context(ctx, zip, shared_strings_index);
+        if (shared_strings_data) {
+            load_shared_strings(shared_strings_data, mz_zip_reader_get_file_size(zip, shared_strings_index),
+                                is_xlsb, shared_strings, opts, log);
+        }
+    }
+
     // Process each sheet
     int processed_sheets = 0;
     for (int i = 0; i < workbook.sheet_count; i++) {
-        printf("Processing sheet %d/%d: '%s'\n", i + 1, workbook.sheet_count, workbook.sheets[i].name);
-        
-        // Extract and parse worksheet
-        int worksheet_index;
-        if (!mz_zip_reader_locate_file(&zip, workbook.sheets[i].filename, &worksheet_index)) {
-            printf("Warning: Could not find worksheet file: %s - skipping\n\n", workbook.sheets[i].filename);
+        if (budget_check()) {
+            skip_sheet_over_budget(workbook.sheets[i].name, log, report);
             continue;
         }
-        
-        size_t worksheet_size = mz_zip_reader_get_file_size(&zip, worksheet_index);
-        char* worksheet_data = malloc(worksheet_size + 1);
-        
-        if (!mz_zip_reader_extract_to_mem(&zip, worksheet_index, worksheet_data, worksheet_size)) {
-            printf("Warning: Could not extract worksheet data for: %s - skipping\n\n", workbook.sheets[i].name);
-            free(worksheet_data);
+        LOG("Processing sheet %d/%d: '%s'\n", i + 1, workbook.sheet_count, workbook.sheets[i].name);
+        double sheet_start_ms = monotonic_ms();
+
+        // Extract and parse worksheet
+        int worksheet_index;
+        if (!mz_zip_reader_locate_file(zip, workbook.sheets[i].filename, &worksheet_index)) {
+            LOG("Warning: Could not find worksheet file: %s - skipping\n\n", workbook.sheets[i].filename);
+            REPORT("sheet\t%s\tskipped\tworksheet not found\n", workbook.sheets[i].name);
             continue;
         }
-        
-        worksheet_data[worksheet_size] = '\0';
-        
+
         // Create safe output filename
-        char output_filename[MAX_SHEET_NAME + 10];
-        create_safe_filename(workbook.sheets[i].name, output_filename, sizeof(output_filename));
-        
+        char output_filename[PATH_MAX];
+        sheet_output_filename(workbook.sheets[i].name, output_dir, output_filename, sizeof(output_filename));
+
+        // Row index: reuse <Sheet>.rowidx for --rows, (re)build it while extracting otherwise
+        bool row_query = opts->rows_to >= 0;
+        char index_filename[PATH_MAX];
+        snprintf(index_filename, sizeof(index_filename), "%.*s.rowidx",
+                 (int)(strlen(output_filename) - 4), output_filename);
+        RowIndex* row_index = &ctx->row_index;
+        bool have_index = !is_xlsb && row_query && load_row_index(zip, worksheet_index, index_filename, row_index);
+        bool build_index = !is_xlsb && !have_index && (row_query || opts->build_index);
+        if (is_xlsb && (row_query || opts->build_index)) {
+            LOG("  Row index is not supported for xlsb - scanning the whole sheet\n");
+        }
+
+        char* worksheet_data = NULL;
+        size_t worksheet_size = mz_zip_reader_get_file_size(zip, worksheet_index);
+        bool partial = false;
+        if (!have_index) {
+            zip->extracted_size = 0;
+            worksheet_data = build_index ? extract_with_row_index(ctx, zip, worksheet_index, row_index)
+                                         : extract_to_context(ctx, zip, worksheet_index);
+            if (!worksheet_data && BUDGET.stop != BUDGET_OK) {
+                // Cut short: convert the complete rows inflated so far, without an index
+                worksheet_size = ctx->xml.data ? complete_rows_size(ctx->xml.data, zip->extracted_size, is_xlsb)
+                                                 : 0;
+                if (worksheet_size == 0) {
+                    skip_sheet_over_budget(workbook.sheets[i].name, log, report);
+                    continue;
+                }
+                LOG("  Inflate stopped by --%s: converting the complete rows so far\n", budget_stop_name());
+                worksheet_data = ctx->xml.data;
+                partial = true;
+                build_index = false;
+            }
+            if (!worksheet_data) {
+                LOG("Warning: Could not extract worksheet data for: %s - skipping\n\n", workbook.sheets[i].name);
+                REPORT("sheet\t%s\tskipped\textract failed\n", workbook.sheets[i].name);
+                continue;
+            }
+        }
+        if (build_index) {
+            if (row_index_save(row_index, index_filename)) {
+                LOG("  Row index: %s (%d checkpoints)\n", index_filename, row_index->count);
+            } else {
+                LOG("Warning: Could not write row index: %s\n", index_filename);
+            }
+        }
+
         // Open output file
-        Filter* output = filter_init(output_filename);
+        Filter* output = open_sheet_output(ctx, workbook.sheets[i].name, output_filename, opts, log, report);
         if (!output) {
-            printf("Warning: Could not create output file: %s - skipping\n\n", output_filename);
-            free(worksheet_data);
+            if (have_index || build_index) row_index_free(row_index);
             continue;
         }
-        
-        printf("  Output file: %s\n", output_filename);
-        
+
         // Parse worksheet and generate TSV
-        parse_worksheet(worksheet_data, &shared_strings, start_row, output);
-        
+        if (have_index) {
+            // Header row (the first with a cell from start_row), then rows_from..rows_to
+            LOG("  Using row index: %s\n", index_filename);
+            ctx->row_xml[0] = inflate_header_row(zip, worksheet_index, row_index_find(row_index, start_row),
+                                                 start_row);
+            char* header_xml = ctx->row_xml[0];
+            int header_row = header_xml ? first_cell_row(header_xml, start_row) : -1;
+            int rows_from = opts->rows_from > header_row ? opts->rows_from : header_row + 1;
+            ctx->row_xml[1] = header_row >= 0 ? inflate_rows(zip, worksheet_index,
+                                                             row_index_find(row_index, rows_from), opts->rows_to)
+                                              : NULL;
+            char* rows_xml = ctx->row_xml[1];
+            if (header_xml && (rows_xml || header_row < 0)) {
+                RowGate* gate = active_row_gate(ctx);
+                row_gate_begin_sheet(gate, shared_strings);
+                if (header_row >= 0) {
+                    parse_worksheet_rows(header_xml, shared_strings, header_row, header_row, gate, output);
+                    parse_worksheet_rows(rows_xml, shared_strings, rows_from, opts->rows_to, gate, output);
+                }
+            } else {
+                LOG("Warning: Could not inflate rows from index: %s\n", index_filename);
+            }
+            free(header_xml);
+            free(rows_xml);
+            ctx->row_xml[0] = NULL;
+            ctx->row_xml[1] = NULL;
+        } else if (partial) {
+            parse_partial_sheet_data(worksheet_data, worksheet_size, is_xlsb, shared_strings, opts,
+                                     active_row_gate(ctx), output);
+        } else {
+            parse_sheet_data(worksheet_data, worksheet_size, is_xlsb, shared_strings, opts,
+                             active_row_gate(ctx), output);
+        }
+        if (have_index || build_index) row_index_free(row_index);
+
         // Cleanup for this sheet
-        filter_close(output);
-        free(worksheet_data);
+        close_sheet_output(ctx, output, workbook.sheets[i].name, sheet_start_ms, log, report);
         processed_sheets++;
-        
-        printf("  Sheet '%s' processed successfully!\n\n", workbook.sheets[i].name);
     }
-    mz_zip_reader_end(&zip);
-    free_shared_strings(&shared_strings);
-    
-    clock_t end_time = clock();
-    double elapsed = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
-    
-    printf("=== Conversion Summary ===\n");
-    printf("Total sheets processed: %d out of %d\n", processed_sheets, workbook.sheet_count);
-    printf("Processing time: %.2f seconds\n", elapsed);
-    
-    if (processed_sheets > 0) {
-        printf("Conversion completed successfully!\n");
-        printf("Output files created:\n");
-        for (int i = 0; i < workbook.sheet_count; i++) {
-            char output_filename[MAX_SHEET_NAME + 10];
-            create_safe_filename(workbook.sheets[i].name, output_filename, sizeof(output_filename));
-            printf("  - %s (from sheet: %s)\n", output_filename, workbook.sheets[i].name);
+    mz_zip_reader_end(zip);
+
+    save_row_hashes(ctx, opts, log);
+    return finish_conversion(&workbook, processed_sheets, shared_strings->count, opts, start_time, start_ms, log, report);
+}
+#undef LOG
+#undef REPORT
+
+// Release what a conversion ended by fatal_error still holds, so the
+// context can take the next --serve job. Output written so far is kept.
+void convert_abort(ConvertContext* ctx) {
+    if (ctx->output) {
+        filter_abort(ctx->output);
+        ctx->output = NULL;
+    }
+    if (USE_IO_URING) uring_io_discard();
+    row_index_free(&ctx->row_index);
+    free(ctx->row_xml[0]);
+    free(ctx->row_xml[1]);
+    ctx->row_xml[0] = NULL;
+    ctx->row_xml[1] = NULL;
+    mz_zip_reader_end(&ctx->zip);
+
+    // The stream is dropped without draining its input (mz_zip_stream_end)
+    free(ctx->stream.buf);
+    memset(&ctx->stream, 0, sizeof(ctx->stream));
+    for (int i = 0; i < ctx->deferred_count; i++) {
+        free(ctx->deferred[i].raw.data);
+    }
+    free(ctx->deferred);
+    ctx->deferred = NULL;
+    ctx->deferred_count = 0;
+    if (ctx->input) {
+        fclose(ctx->input);
+        ctx->input = NULL;
+    }
+}
+
+// Serve request: <input.xlsx>\t<output_dir>[\t<option>...]
+void handle_serve_request(void* arg, char* line, FILE* out) {
+    ConvertContext* ctx = arg;
+    ConvertOptions opts = CONVERT_OPTIONS_DEFAULT;
+    opts.threads = 1;  // workers already run in parallel
+
+    char* save = NULL;
+    char* input_file = strtok_r(line, "\t", &save);
+    char* output_dir = strtok_r(NULL, "\t", &save);
+    if (!input_file || !output_dir) {
+        fprintf(out, "error expected <input.xlsx>\\t<output_dir>[\\t<option>...]\n");
+        return;
+    }
+
+    char* arg_str;
+    while ((arg_str = strtok_r(NULL, "\t", &save)) != NULL) {
+        if (!parse_convert_option(arg_str, &opts)) {
+            fprintf(out, "error unknown option %s\n", arg_str);
+            return;
         }
-        return 0;
+    }
+    // Workers share the daemon's stdin and must not block on a pipe
+    if (strcmp(input_file, "-") == 0 || opts.stream) {
+        fprintf(out, "error stdin input and --stream are not available in serve requests\n");
+        return;
+    }
+
+    // A fatal error fails this request only
+    FatalScope scope;
+    FATAL_SCOPE = &scope;
+    if (setjmp(scope.jump) == 0) {
+        convert_workbook(ctx, input_file, output_dir, &opts, NULL, out);
     } else {
-        printf("No sheets were processed successfully.\n");
+        convert_abort(ctx);
+        fprintf(out, "error %s\n", scope.message);
+    }
+    FATAL_SCOPE = NULL;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <input.xlsx|-> [start_row] [--no-wildcard] [--io-uring] [--threads=N] [--profile-columns]\n"
+               "       [--build-index] [--rows=A:B] [--stream] [--shard-rows=N] [--partitions=K --partition-by=COL]\n"
+               "       [--diff-against=PATH] [--where=COL=V1,V2 | COL!=V | COL<N | COL>N]...\n"
+               "       [--sort-by=COL[,COL] [--sort-memory=MB]] [--format=tsv|col] [--deadline=MS] [--max-cells=N]\n",
+               argv[0]);
+        printf("       %s --serve <socket_path> [--workers=N]\n", argv[0]);
+        printf("  start_row: 1-based row number to start conversion (default: 1)\n");
+        printf("  -: read the xlsx from stdin (e.g. curl ... | %s -), converting sheets as they arrive\n", argv[0]);
+        printf("  --stream: read <input.xlsx> front to back like stdin (named pipes, /dev/fd/N)\n");
+        printf("  --diff-against=PATH: write only rows added/removed since the run that saved PATH to\n");
+        printf("              <Sheet>.delta.tsv (op +/-, row_hash, cells), then save this run's row hashes to PATH;\n");
+        printf("              only hashes are saved, so removed (-) rows have empty cells; not with --where or --rows\n");
+        printf("  --where=EXPR: keep only data rows where EXPR holds (repeat to require several);\n");
+        printf("              COL=V1,V2 (equals one of), COL!=V1,V2, COL<N, COL>N (numeric); COL is a header name\n");
+        printf("  --sort-by=COL[,COL]: write data rows ordered by these header columns (byte order, like\n");
+        printf("              LC_ALL=C sort; ties keep sheet order), spilling sorted runs to disk past --sort-memory\n");
+        printf("  --sort-memory=MB: memory for --sort-by before spilling (default: %d)\n", SORT_MEMORY_DEFAULT_MB);
+        printf("  --format=col: write each sheet as <Sheet>.xcol, a columnar file with typed row groups and\n");
+        printf("              a string dictionary (read it with xlsx2col-cat); not with split, delta or sorted output\n");
+        printf("  --deadline=MS: stop after MS milliseconds, --max-cells=N: after N worksheet cells; the rows\n");
+        printf("              finished so far are kept, the output is marked truncated and the exit status is %d\n",
+               EXIT_TRUNCATED);
+        printf("  --shard-rows=N: write <Sheet>.00000.tsv, <Sheet>.00001.tsv, ... with N data rows each\n");
+        printf("  --partitions=K --partition-by=COL: route rows to <Sheet>.p00000.tsv .. p<K-1> by a hash\n");
+        printf("              of column COL (header name); combined with --shard-rows: <Sheet>.pNNNNN.NNNNN.tsv;\n");
+        printf("              --partition-by without --partitions is an error\n");
+        printf("  --io-uring: write output with async io_uring writes (falls back to write() if unavailable)\n");
+        printf("  --threads=N: threads for parsing large shared-string tables (default: number of CPUs)\n");
+        printf("  --profile-columns: also write <Sheet>.stats.json (type, nulls, min/max, max length, distinct)\n");
+        printf("  --build-index: also write <Sheet>.rowidx, a seekable row index for --rows\n");
+        printf("  --rows=A:B: output only the header row and rows A..B (1-based); uses <Sheet>.rowidx\n");
+        printf("              to resume inflation near row A, building it first if missing\n");
+        printf("  --serve: run as a conversion daemon on a Unix socket; each request line is\n");
+        printf("           <input.xlsx>\\t<output_dir>[\\t<option>...] (options as above)\n");
+        printf("  --workers=N (or --workers N): worker threads for --serve (default: number of CPUs)\n");
+        printf("\n");
+        printf("Wildcard (*) character behavior:\n");
+        printf("  Default mode:\n");
+        printf("    - * characters are removed from sheet/column names in output\n");
+        printf("    - Example: '*Sales' -> 'Sales.tsv', '*ID' column -> 'ID'\n");
+        printf("  --no-wildcard mode:\n");
+        printf("    - Sheets containing * will be skipped entirely\n");
+        printf("    - Columns containing * will be excluded from output\n");
+        printf("\n");
+        printf("Note: Only A-Z, a-z, 0-9, -, _, * characters are valid in sheet/column names\n");
+        printf("      Names with spaces, special characters, or non-ASCII will be skipped\n");
         return 1;
     }
+    
+    bool serve = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--serve") == 0) serve = true;
+    }
+    if (serve) {
+        // --serve <socket_path> and --workers N (or --workers=N) in any order
+        const char* socket_path = NULL;
+        int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        for (int i = 1; i < argc; i++) {
+            bool takes_value = strcmp(argv[i], "--serve") == 0 || strcmp(argv[i], "--workers") == 0;
+            if (takes_value && i + 1 >= argc) {
+                printf("Error: %s requires %s\n", argv[i],
+                       strcmp(argv[i], "--serve") == 0 ? "a socket path" : "a worker count");
+                return 1;
+            }
+            if (strcmp(argv[i], "--serve") == 0) {
+                socket_path = argv[++i];
+            } else if (strcmp(argv[i], "--workers") == 0) {
+                workers = atoi(argv[++i]);
+            } else if (strncmp(argv[i], "--workers=", 10) == 0) {
+                workers = atoi(argv[i] + 10);
+            } else {
+                printf("Error: Unknown option for --serve: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        if (workers < 1) workers = 1;
+        return serve_run(socket_path, workers, convert_context_create, convert_context_destroy,
+                         handle_serve_request);
+    }
+    
+    const char* input_file = argv[1];
+    ConvertOptions opts = CONVERT_OPTIONS_DEFAULT;
+    for (int i = 2; i < argc; i++) {
+        if (!parse_convert_option(argv[i], &opts)) {
+            printf("Error: Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    
+    ConvertContext* ctx = convert_context_create();
+    int result = convert_workbook(ctx, input_file, NULL, &opts, stdout, NULL);
+    convert_context_destroy(ctx);
+    return result;
 } 
 
 // *** xlsx_to_tsv END